@@ -24,6 +24,9 @@
 #define HAVE_STRING_H
 #define HAVE_SYS_TIME_H
 #define HAVE_UNISTD_H
+#ifdef __linux__
+#define HAVE_SYS_INOTIFY_H
+#endif
 #endif
 
 /*
@@ -16,11 +16,34 @@
 
 #include "tig/view.h"
 
+/*
+ * Positions of the file headers, chunk headers and diffstats of a diff,
+ * recorded while it is read so they can be found by binary search. The
+ * index is only valid if it was built from the first line. Views which
+ * change the lines of the diff in place clear valid, after which lines
+ * are searched one by one.
+ */
+struct diff_index {
+	unsigned long *header;		/* File headers. */
+	size_t headers;
+	unsigned long *chunk;		/* Chunk headers. */
+	size_t chunks;
+	unsigned long *file;		/* File headers with a diffstat entry. */
+	size_t files;
+	unsigned long *stat;		/* First line of each diffstat. */
+	size_t stats;
+	unsigned long last_stat;
+	bool valid;
+};
+
 struct diff_state {
 	bool after_commit_title;
 	bool after_diff;
 	bool reading_diff_stat;
 	bool combined_diff;
+	bool reading_lazy_stat;
+	unsigned long changes;
+	struct diff_index index;
 };
 
 bool update_diff_context(enum request request);
@@ -28,6 +51,15 @@ enum request diff_common_edit(struct view *view, enum request request, struct li
 bool diff_common_read(struct view *view, const char *data, struct diff_state *state);
 bool diff_common_draw(struct view *view, struct line *line, unsigned int lineno);
 enum request diff_common_enter(struct view *view, enum request request, struct line *line);
+void diff_common_done(struct diff_state *state);
+
+struct line *diff_find_line_by_type(struct view *view, struct line *line, enum line_type type, int direction);
+
+#define diff_find_prev_line_by_type(view, line, type) \
+	diff_find_line_by_type(view, line, type, -1)
+
+#define diff_find_next_line_by_type(view, line, type) \
+	diff_find_line_by_type(view, line, type, 1)
 
 unsigned int diff_get_lineno(struct view *view, struct line *line);
 const char *diff_get_pathname(struct view *view, struct line *line);
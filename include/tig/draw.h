@@ -27,6 +27,7 @@ enum align {
 
 #define VIEW_MAX_LEN(view) ((view)->width + (view)->pos.col - (view)->col)
 
+void set_view_attr(struct view *view, enum line_type type);
 bool draw_text(struct view *view, enum line_type type, const char *string);
 bool draw_text_overflow(struct view *view, const char *text, bool on, int overflow, enum line_type type);
 bool PRINTF_LIKE(3, 4) draw_formatted(struct view *view, enum line_type type, const char *format, ...);
@@ -47,6 +48,8 @@ bool draw_refs(struct view *view, struct ref_list *refs);
 #define draw_commit_title(view, text, offset) \
 	draw_text_overflow(view, text, opt_title_overflow > 0, opt_title_overflow + offset, LINE_DEFAULT)
 
+void reset_line_widths(struct view *view);
+void reset_view_rows(struct view *view);
 void redraw_view(struct view *view);
 void redraw_view_from(struct view *view, int lineno);
 void redraw_view_dirty(struct view *view);
@@ -54,6 +54,7 @@ struct io {
 	size_t bufalloc;	/* Allocated buffer size. */
 	size_t bufsize;		/* Buffer content size. */
 	char *bufpos;		/* Current buffer position. */
+	size_t bufscan;		/* Buffer content searched for the separator. */
 	unsigned int eof:1;	/* Has end of file been reached. */
 	int status:8;		/* Status exit code. */
 };
@@ -64,6 +65,7 @@ bool io_open(struct io *io, const char *fmt, ...) PRINTF_LIKE(2, 3);
 bool io_from_string(struct io *io, const char *str);
 bool io_kill(struct io *io);
 bool io_done(struct io *io);
+bool io_is_running(struct io *io);
 bool io_run(struct io *io, enum io_type type, const char *dir, char * const env[], const char *argv[], ...);
 bool io_run_bg(const char **argv);
 bool io_run_fg(const char **argv, const char *dir);
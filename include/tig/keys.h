@@ -22,6 +22,7 @@
  */
 
 struct keybinding;
+struct keymap_index;
 
 struct keymap {
 	const char *name;
@@ -29,6 +30,8 @@ struct keymap {
 	struct keybinding *data;
 	size_t size;
 	bool hidden;
+	struct keymap_index *index;
+	bool index_valid;
 };
 
 void add_keymap(struct keymap *keymap);
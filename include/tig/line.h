@@ -52,6 +52,7 @@ struct ref;
 	_(FILENAME,  		""), \
 	_(FILE_SIZE, 		""), \
 	_(LINE_NUMBER,		""), \
+	_(SEARCH_RESULT,	""), \
 	_(TITLE_BLUR,		""), \
 	_(TITLE_FOCUS,		""), \
 	_(MAIN_COMMIT,		""), \
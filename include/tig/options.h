@@ -23,12 +23,15 @@
 
 #define OPTION_INFO(_) \
 	_(author_width,			int) \
+	_(blame_cache,			bool) \
 	_(blame_options,		const char **) \
 	_(commit_order,			enum commit_order) \
 	_(diff_context,			int) \
+	_(diff_lazy_threshold,		int) \
 	_(diff_options,			const char **) \
 	_(editor_line_number,		bool) \
 	_(focus_child,			bool) \
+	_(frame_rate,			int) \
 	_(horizontal_scroll,		double) \
 	_(id_width,			int) \
 	_(ignore_case,			bool) \
@@ -55,6 +58,7 @@
 	_(tab_size,			int) \
 	_(title_overflow,		int) \
 	_(vertical_split,		enum vertical_split) \
+	_(watch_worktree,		bool) \
 	_(wrap_lines,			bool) \
 
 #define DEFINE_OPTION_EXTERNS(name, type) extern type opt_##name;
@@ -23,6 +23,7 @@ enum request pager_request(struct view *view, enum request request, struct line
 bool pager_grep(struct view *view, struct line *line);
 void pager_select(struct view *view, struct line *line);
 bool pager_open(struct view *view, enum open_flags flags);
+bool pager_rewrap_view(struct view *view);
 
 extern struct view_ops pager_ops;
 
@@ -17,6 +17,23 @@
 #include "tig/tig.h"
 #include "tig/util.h"
 
+/*
+ * Commit metadata shared between views.
+ */
+
+#define SIZEOF_OID	20	/* Size of binary SHA1 IDs. */
+
+struct commit_info {
+	char id[SIZEOF_REV];		/* SHA1 ID. */
+	const struct ident *author;	/* Author of the commit or NULL. */
+	struct time time;		/* Date from the author ident. */
+	char *title;			/* First line of the commit message. */
+	unsigned char oid[SIZEOF_OID];	/* Binary SHA1 ID. */
+	unsigned int refs;		/* Number of references from views. */
+	struct commit_info *prev;	/* Unused entries, oldest first. */
+	struct commit_info *next;
+};
+
 struct chunk_header_position {
 	unsigned long position;
 	unsigned long lines;
@@ -32,9 +49,7 @@ bool parse_chunk_lineno(unsigned long *lineno, const char *chunk, int marker);
 
 struct blame_commit {
 	char id[SIZEOF_REV];		/* SHA1 ID. */
-	char title[128];		/* First line of the commit message. */
-	const struct ident *author;	/* Author of the commit. */
-	struct time time;		/* Date from the author ident. */
+	struct commit_info *info;	/* Shared commit metadata. */
 	const char *filename;		/* Name of file. */
 	char parent_id[SIZEOF_REV];	/* Parent/previous SHA1 ID. */
 	const char *parent_filename;	/* Parent/previous name of file. */
@@ -62,6 +77,9 @@ size_t parse_size(const char *text, int *max_digits);
  */
 const char *get_path(const char *path);
 struct ident *get_author(const char *name, const char *email);
+struct commit_info *get_commit_info(const char *id);
+void put_commit_info(struct commit_info *info);
+bool set_commit_info_title(struct commit_info *info, const char *title);
 
 #endif
 /* vim: set ts=8 sw=8 noexpandtab: */
@@ -45,6 +45,7 @@
 	REQ_(STAGE_UPDATE_LINE,	"Stage/unstage single line"), \
 	REQ_(STAGE_NEXT,	"Jump to next diff chunk"), \
 	REQ_(STAGE_SPLIT_CHUNK,	"Split current diff chunk"), \
+	REQ_(STAGE_SELECT_RANGE, "Start or clear range selection"), \
 	REQ_(DIFF_CONTEXT_UP,	"Increase the diff context"), \
 	REQ_(DIFF_CONTEXT_DOWN,	"Decrease the diff context"), \
 	\
@@ -96,7 +97,7 @@
 	REQ_(EDIT,		"Open in editor"), \
 	REQ_(PROMPT,		"Open the prompt"), \
 	REQ_(SCREEN_REDRAW,	"Redraw the screen"), \
-	REQ_(STOP_LOADING,	"Stop all loading views"), \
+	REQ_(STOP_LOADING,	"Stop all loading views and searches"), \
 	REQ_(SHOW_VERSION,	"Show version information"), \
 	REQ_(NONE,		"Do nothing")
 
@@ -39,6 +39,7 @@ bool status_update_file(struct status *status, enum line_type type);
 bool status_update_files(struct view *view, struct line *line);
 
 bool status_revert(struct status *status, enum line_type type, bool has_none);
+bool status_revert_files(struct view *view, struct line *line);
 bool status_exists(struct view *view, struct status *status, enum line_type type);
 void status_restore(struct view *view);
 
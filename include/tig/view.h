@@ -82,6 +82,13 @@ struct view {
 	/* Searching */
 	char grep[SIZEOF_STR];	/* Search string */
 	regex_t *regex;		/* Pre-compiled regexp */
+	bool grep_literal;	/* Search string has no regexp operators */
+	bool grep_icase;	/* Search ignores case */
+	unsigned long *grep_searched; /* Bitmap of lines already searched */
+	unsigned long *grep_matched; /* Bitmap of lines matching the search */
+	size_t grep_bitmap_size; /* Words in the search bitmaps */
+	unsigned long grep_counted; /* Lines counted for the match total */
+	size_t grep_matches;	/* Matching lines counted so far */
 
 	/* If non-NULL, points to the view that opened this view. If this view
 	 * is closed tig will switch back to the parent view. */
@@ -103,6 +110,7 @@ struct view {
 	unsigned long col;	/* Column when drawing. */
 	bool has_scrolled;	/* View was scrolled. */
 	bool force_redraw;	/* Whether to force a redraw after reading. */
+	int wrap_width;		/* Width used when wrapping lines. */
 
 	/* Loading */
 	const char **argv;	/* Shell command arguments. */
@@ -159,6 +167,8 @@ struct view_ops {
 	void (*select)(struct view *view, struct line *line);
 	/* Release resources when reloading the view */
 	void (*done)(struct view *view);
+	/* Advance background work; returns TRUE while it is pending. */
+	bool (*poll)(struct view *view);
 };
 
 /*
@@ -192,7 +202,12 @@ void move_view(struct view *view, enum request request);
 
 void search_view(struct view *view, enum request request);
 void find_next(struct view *view, enum request request);
+bool update_search(struct view *view);
+bool stop_search(void);
 bool grep_text(struct view *view, const char *text[]);
+bool grep_match(struct view *view, const char *text, regmatch_t *match, int flags);
+bool search_line_matches(struct view *view, struct line *line);
+void reset_search_results(struct view *view);
 
 /*
  * View history
@@ -302,6 +317,7 @@ struct line *add_line_alloc_(struct view *view, void **ptr, enum line_type type,
 struct line *add_line_nodata(struct view *view, enum line_type type);
 struct line *add_line_text(struct view *view, const char *text, enum line_type type);
 struct line * PRINTF_LIKE(3, 4) add_line_format(struct view *view, enum line_type type, const char *fmt, ...);
+void delete_line(struct view *view, struct line *line);
 
 #endif
 /* vim: set ts=8 sw=8 noexpandtab: */
@@ -0,0 +1,41 @@
+/* Copyright (c) 2006-2014 Jonas Fonseca <jonas.fonseca@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef TIG_WATCH_H
+#define TIG_WATCH_H
+
+#include "tig/tig.h"
+
+/*
+ * Working tree watcher.
+ *
+ * Records the paths changed in the working tree since the last reset
+ * so views can limit their reloads to those paths. Changes to the index
+ * made by Tig itself must be bracketed by watch_index_begin() and
+ * watch_index_end() with the affected paths passed to watch_mark_path()
+ * so they are not mistaken for foreign index updates.
+ */
+
+#define WATCH_MAX_PATHS	256	/* Max paths to track before giving up. */
+
+bool watch_init(void);
+bool watch_is_active(void);
+bool watch_get_paths(const char ***paths, size_t *paths_size);
+void watch_reset(void);
+unsigned long watch_generation(void);
+void watch_mark_path(const char *path);
+void watch_index_begin(void);
+void watch_index_end(void);
+
+#endif
+/* vim: set ts=8 sw=8 noexpandtab: */
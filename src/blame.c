@@ -21,6 +21,8 @@
 #include "tig/draw.h"
 #include "tig/git.h"
 
+#include <dirent.h>
+
 /*
  * Blame backend
  *
@@ -30,6 +32,12 @@
  *     filesystem or using git-cat-file.
  *  2. Then blame information is incrementally added by
  *     reading output from git-blame.
+ *
+ * The output of git-blame for a given commit and file never changes, so
+ * it is kept in a small LRU cache and replayed when the same blame is
+ * opened again. While the view is idle the parent of the commit under
+ * the cursor is blamed in the background so stepping back through the
+ * history of a file does not have to wait for git-blame.
  */
 
 struct blame_history_state {
@@ -45,17 +53,574 @@ struct blame {
 	char text[1];
 };
 
+struct blame_output {
+	char *data;
+	size_t size;
+};
+
 struct blame_state {
 	struct blame_commit *commit;
 	int blamed;
 	bool done_reading;
 	bool auto_filename_display;
+	bool capturing;			/* Save output to the cache. */
+	struct blame_output output;
 	/* The history state for the current view is cached in the view
 	 * state so it always matches what was used to load the current blame
 	 * view. */
 	struct blame_history_state history_state;
 };
 
+/*
+ * Blame cache
+ */
+
+#define BLAME_CACHE_SIZE	16
+
+struct blame_cache_entry {
+	char id[SIZEOF_REV];		/* SHA1 ID of the blamed commit. */
+	const char *filename;		/* Name of the blamed file. */
+	char *args;			/* Options passed to git-blame. */
+	char *data;			/* Output of git-blame --incremental. */
+	unsigned long used;		/* Time of last use. */
+};
+
+static struct blame_cache_entry blame_cache[BLAME_CACHE_SIZE];
+static unsigned long blame_cache_clock;
+
+/* Background job blaming the parent of the selected commit. */
+static struct {
+	struct io io;
+	bool running;
+	char id[SIZEOF_REV];
+	const char *filename;
+	char args[SIZEOF_STR];
+	struct blame_output output;
+} blame_prefetch;
+
+DEFINE_ALLOCATOR(realloc_blame_output, char, 4096)
+
+static bool
+blame_output_append(struct blame_output *output, const char *data, size_t datalen)
+{
+	if (!realloc_blame_output(&output->data, output->size, datalen + 1))
+		return FALSE;
+
+	memcpy(output->data + output->size, data, datalen);
+	output->size += datalen;
+	output->data[output->size] = 0;
+	return TRUE;
+}
+
+static void
+blame_output_free(struct blame_output *output)
+{
+	free(output->data);
+	output->data = NULL;
+	output->size = 0;
+}
+
+/* FNV-1a hash used for naming and keying cached blames. */
+static unsigned int
+blame_cache_hash(unsigned int hash, const char *data, size_t datalen)
+{
+	while (datalen--) {
+		hash ^= (unsigned char) *data++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static unsigned int
+blame_cache_hash_file(unsigned int hash, const char *path)
+{
+	char buf[BUFSIZ];
+	ssize_t readsize;
+	struct io io;
+
+	if (!io_open(&io, "%s%s", *path == '/' ? "" : repo.cdup, path))
+		return hash;
+
+	while ((readsize = io_read(&io, buf, sizeof(buf))) > 0)
+		hash = blame_cache_hash(hash, buf, readsize);
+	io_done(&io);
+	return hash;
+}
+
+static int
+read_blame_cache_config(char *name, size_t namelen, char *value, size_t valuelen, void *data)
+{
+	unsigned int *hash = data;
+
+	*hash = blame_cache_hash(*hash, name, namelen + 1);
+	*hash = blame_cache_hash(*hash, value, valuelen + 1);
+	if (!strcmp(name, "mailmap.file") || !strcmp(name, "blame.ignorerevsfile"))
+		*hash = blame_cache_hash_file(*hash, value);
+
+	return OK;
+}
+
+/* Authors and attributions also depend on the mailmap and the blame
+ * configuration, which are summarized once per session. */
+static unsigned int
+blame_cache_environment(void)
+{
+	static const char *config_argv[] = {
+		"git", "config", "--get-regexp", "^(blame|mailmap)\\.", NULL
+	};
+	static unsigned int hash;
+	static bool loaded;
+
+	if (!loaded) {
+		hash = blame_cache_hash_file(2166136261U, ".mailmap");
+		io_run_load(config_argv, " ", read_blame_cache_config, &hash);
+		loaded = TRUE;
+	}
+
+	return hash;
+}
+
+/* Only blames of full commit IDs are immutable. */
+static bool
+blame_cache_key(const char *id, char args[SIZEOF_STR])
+{
+	char rev[SIZEOF_REV];
+	size_t argslen = 0;
+
+	if (strlen(id) != SIZEOF_REV - 1 || string_rev_is_null(id))
+		return FALSE;
+
+	string_copy_rev(rev, id);
+	if (!iscommit(rev))
+		return FALSE;
+
+	args[0] = 0;
+	if (opt_blame_options &&
+	    !argv_to_string(opt_blame_options, args, SIZEOF_STR, " "))
+		return FALSE;
+
+	argslen = strlen(args);
+	return string_nformat(args, SIZEOF_STR, &argslen, "%s[env %08x]",
+			      argslen ? " " : "", blame_cache_environment());
+}
+
+static struct blame_cache_entry *
+blame_cache_get(const char *id, const char *filename, const char *args)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(blame_cache); i++) {
+		struct blame_cache_entry *entry = &blame_cache[i];
+
+		if (entry->data && !strcmp(entry->id, id) &&
+		    !strcmp(entry->filename, filename) &&
+		    !strcmp(entry->args, args)) {
+			entry->used = ++blame_cache_clock;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/* Takes ownership of the output data. */
+static struct blame_cache_entry *
+blame_cache_put(const char *id, const char *filename, const char *args,
+		struct blame_output *output)
+{
+	struct blame_cache_entry *entry = blame_cache_get(id, filename, args);
+	int i;
+
+	if (!entry) {
+		entry = &blame_cache[0];
+		for (i = 1; i < ARRAY_SIZE(blame_cache); i++)
+			if (blame_cache[i].used < entry->used)
+				entry = &blame_cache[i];
+	}
+
+	free(entry->args);
+	free(entry->data);
+	entry->args = strdup(args);
+	if (!entry->args) {
+		entry->data = NULL;
+		blame_output_free(output);
+		return NULL;
+	}
+
+	string_copy_rev(entry->id, id);
+	entry->filename = filename;
+	entry->data = output->data;
+	entry->used = ++blame_cache_clock;
+	output->data = NULL;
+	output->size = 0;
+	return entry;
+}
+
+/*
+ * Blame results are also saved in the repository below
+ * $GIT_DIR/tig/blame so they survive restarts. Each file holds a
+ * header identifying the blamed file and options followed by the
+ * output of git-blame --incremental, which already lists each commit's
+ * metadata once followed by the line ranges it is blamed for.
+ */
+
+#define BLAME_DISK_CACHE_SIZE	512	/* Max files to keep on disk. */
+
+static bool
+blame_disk_cache_path(char path[SIZEOF_STR], const char *id, const char *filename, const char *args)
+{
+	const char *key[] = { filename, args };
+	unsigned int hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(key); i++)
+		hash = blame_cache_hash(hash, key[i], strlen(key[i]) + 1);
+
+	return *repo.git_dir &&
+	       string_format_size(path, SIZEOF_STR, "%s/tig/blame/%s-%08x", repo.git_dir, id, hash);
+}
+
+static bool
+blame_disk_cache_header(char header[SIZEOF_STR], const char *filename, const char *args)
+{
+	return string_format_size(header, SIZEOF_STR, "tig-blame 1\n%s\n%s\n", filename, args);
+}
+
+static struct blame_cache_entry *
+blame_disk_cache_load(const char *id, const char *filename, const char *args)
+{
+	struct blame_output output = {};
+	char path[SIZEOF_STR];
+	char header[SIZEOF_STR];
+	char buf[BUFSIZ];
+	size_t headerlen;
+	ssize_t readsize;
+	struct io io;
+	bool ok = TRUE;
+
+	if (!opt_blame_cache ||
+	    !blame_disk_cache_path(path, id, filename, args) ||
+	    !blame_disk_cache_header(header, filename, args) ||
+	    !io_open(&io, "%s", path))
+		return NULL;
+
+	while (ok && (readsize = io_read(&io, buf, sizeof(buf))) > 0)
+		ok = blame_output_append(&output, buf, readsize);
+	ok = ok && io_eof(&io) && !io_error(&io);
+	io_done(&io);
+
+	headerlen = strlen(header);
+	if (!ok || !output.data || output.size <= headerlen ||
+	    memcmp(output.data, header, headerlen)) {
+		blame_output_free(&output);
+		return NULL;
+	}
+
+	output.size -= headerlen;
+	memmove(output.data, output.data + headerlen, output.size + 1);
+
+	/* Keep recently used results when pruning. */
+	utimes(path, NULL);
+	return blame_cache_put(id, filename, args, &output);
+}
+
+static bool
+blame_disk_cache_write(int fd, const char *data)
+{
+	size_t datalen = strlen(data);
+
+	while (datalen > 0) {
+		ssize_t written = write(fd, data, datalen);
+
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return FALSE;
+		data += written;
+		datalen -= written;
+	}
+
+	return TRUE;
+}
+
+DEFINE_ALLOCATOR(realloc_mtimes, time_t, 64)
+
+static int
+compare_mtimes(const void *a, const void *b)
+{
+	time_t x = *(const time_t *) a;
+	time_t y = *(const time_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Remove the least recently used files once the cache grows too big. */
+static void
+blame_disk_cache_prune(const char *dirname)
+{
+	time_t *mtimes = NULL;
+	size_t count = 0;
+	char path[SIZEOF_STR];
+	struct dirent *entry;
+	struct stat st;
+	DIR *dir;
+
+	dir = opendir(dirname);
+	if (!dir)
+		return;
+
+	while ((entry = readdir(dir))) {
+		if (*entry->d_name == '.' ||
+		    !string_format(path, "%s/%s", dirname, entry->d_name) ||
+		    stat(path, &st) ||
+		    !realloc_mtimes(&mtimes, count, 1))
+			continue;
+		mtimes[count++] = st.st_mtime;
+	}
+
+	if (count > BLAME_DISK_CACHE_SIZE) {
+		time_t oldest;
+
+		qsort(mtimes, count, sizeof(*mtimes), compare_mtimes);
+		oldest = mtimes[count - BLAME_DISK_CACHE_SIZE];
+
+		rewinddir(dir);
+		while ((entry = readdir(dir))) {
+			if (*entry->d_name == '.' ||
+			    !string_format(path, "%s/%s", dirname, entry->d_name) ||
+			    stat(path, &st) || st.st_mtime >= oldest)
+				continue;
+			unlink(path);
+		}
+	}
+
+	closedir(dir);
+	free(mtimes);
+}
+
+static void
+blame_disk_cache_save(const char *id, const char *filename, const char *args, const char *data)
+{
+	static bool pruned;
+	char dirname[SIZEOF_STR];
+	char path[SIZEOF_STR];
+	char tmp[SIZEOF_STR];
+	char header[SIZEOF_STR];
+	bool ok;
+	int fd;
+
+	if (!opt_blame_cache ||
+	    !blame_disk_cache_path(path, id, filename, args) ||
+	    !blame_disk_cache_header(header, filename, args) ||
+	    !string_format(dirname, "%s/tig", repo.git_dir) ||
+	    (mkdir(dirname, 0777) && errno != EEXIST) ||
+	    !string_format(dirname, "%s/tig/blame", repo.git_dir) ||
+	    (mkdir(dirname, 0777) && errno != EEXIST) ||
+	    !string_format(tmp, "%s/.tmp-XXXXXX", dirname))
+		return;
+
+	fd = mkstemp(tmp);
+	if (fd == -1)
+		return;
+
+	/* Write to a temporary file so readers never see partial data. */
+	ok = blame_disk_cache_write(fd, header) &&
+	     blame_disk_cache_write(fd, data);
+	if (close(fd) || !ok || rename(tmp, path)) {
+		unlink(tmp);
+		return;
+	}
+
+	if (!pruned) {
+		blame_disk_cache_prune(dirname);
+		pruned = TRUE;
+	}
+}
+
+static struct blame_cache_entry *
+blame_cache_lookup(const char *id, const char *filename, const char *args)
+{
+	struct blame_cache_entry *entry = blame_cache_get(id, filename, args);
+
+	return entry ? entry : blame_disk_cache_load(id, filename, args);
+}
+
+/* Save new git-blame output both in memory and on disk. */
+static void
+blame_cache_store(const char *id, const char *filename, const char *args,
+		  struct blame_output *output)
+{
+	blame_disk_cache_save(id, filename, args, output->data);
+	blame_cache_put(id, filename, args, output);
+}
+
+static void
+blame_stop_prefetch(void)
+{
+	if (blame_prefetch.running) {
+		io_kill(&blame_prefetch.io);
+		io_done(&blame_prefetch.io);
+	}
+	blame_output_free(&blame_prefetch.output);
+	blame_prefetch.running = FALSE;
+}
+
+static bool
+blame_start_prefetch(struct view *view, const char *id, const char *filename, const char *args)
+{
+	const char *blame_argv[] = {
+		"git", "blame", encoding_arg, "%(blameargs)", "--incremental",
+			id, "--", filename, NULL
+	};
+	const char **argv = NULL;
+	bool ok;
+
+	string_copy_rev(blame_prefetch.id, id);
+	blame_prefetch.filename = filename;
+	string_ncopy(blame_prefetch.args, args, strlen(args));
+
+	ok = argv_format(view->env, &argv, blame_argv, FALSE, FALSE) &&
+	     io_run(&blame_prefetch.io, IO_RD, repo.cdup, opt_env, argv);
+	argv_free(argv);
+	free(argv);
+
+	blame_prefetch.running = ok;
+	return ok;
+}
+
+/*
+ * Blame shards
+ *
+ * Large files are blamed by several git-blame processes each covering
+ * a range of lines given with -L. The first range is read through the
+ * view pipe and the others while polling. When the view pipe is done
+ * the next running shard takes its place so the view keeps loading
+ * until all shards are done.
+ */
+
+#define BLAME_SHARD_LINES	2500	/* Min lines per git-blame process. */
+#define BLAME_MAX_SHARDS	16
+
+struct blame_shard {
+	struct io io;
+	struct blame_commit *commit;	/* Commit whose info is being read. */
+	struct blame_output output;	/* Output saved for the cache. */
+	bool running;
+};
+
+static struct {
+	struct view *view;
+	struct blame_shard shard[BLAME_MAX_SHARDS];
+	size_t size;
+} blame_shards;
+
+static size_t
+blame_shard_count(struct view *view)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t shards = view->lines / BLAME_SHARD_LINES;
+	int i;
+
+	/* Line ranges given by the user can not be split. */
+	for (i = 0; opt_blame_options && opt_blame_options[i]; i++)
+		if (!prefixcmp(opt_blame_options[i], "-L"))
+			return 1;
+
+	if (cpus > 0 && shards > (size_t) cpus)
+		shards = cpus;
+	return MAX(1, MIN(shards, BLAME_MAX_SHARDS));
+}
+
+static void
+blame_stop_shards(void)
+{
+	size_t i;
+
+	for (i = 0; i < blame_shards.size; i++) {
+		struct blame_shard *shard = &blame_shards.shard[i];
+
+		if (shard->running) {
+			io_kill(&shard->io);
+			io_done(&shard->io);
+		}
+		blame_output_free(&shard->output);
+	}
+
+	memset(&blame_shards, 0, sizeof(blame_shards));
+}
+
+/* Start the shards for all but the first range of lines. */
+static bool
+blame_start_shards(struct view *view, size_t shards)
+{
+	char range[SIZEOF_STR];
+	const char *blame_argv[] = {
+		"git", "blame", encoding_arg, "%(blameargs)", "--incremental", range,
+			*view->env->ref ? view->env->ref : "--incremental", "--", view->env->file, NULL
+	};
+	const char **argv = NULL;
+	size_t i;
+
+	blame_stop_shards();
+	blame_shards.view = view;
+
+	for (i = 1; i < shards; i++) {
+		struct blame_shard *shard = &blame_shards.shard[blame_shards.size++];
+		size_t first = i * view->lines / shards + 1;
+		size_t last = (i + 1) * view->lines / shards;
+
+		if (!string_format(range, "-L%zu,%zu", first, last) ||
+		    !argv_format(view->env, &argv, blame_argv, FALSE, FALSE) ||
+		    !io_run(&shard->io, IO_RD, repo.cdup, opt_env, argv))
+			break;
+		shard->running = TRUE;
+	}
+
+	argv_free(argv);
+	free(argv);
+
+	if (i < shards)
+		blame_stop_shards();
+	return i == shards;
+}
+
+static struct blame_shard *
+blame_next_shard(struct view *view)
+{
+	size_t i;
+
+	for (i = 0; blame_shards.view == view && i < blame_shards.size; i++)
+		if (blame_shards.shard[i].running)
+			return &blame_shards.shard[i];
+
+	return NULL;
+}
+
+static void
+blame_capture_line(struct blame_state *state, struct blame_output *output, const char *line)
+{
+	if (state->capturing &&
+	    (!blame_output_append(output, line, strlen(line)) ||
+	     !blame_output_append(output, "\n", 1))) {
+		blame_output_free(output);
+		state->capturing = FALSE;
+	}
+}
+
+/* Append the output of a shard once its lines can no longer be
+ * interleaved with those of another shard. */
+static void
+blame_capture_output(struct blame_state *state, struct blame_output *output)
+{
+	if (state->capturing && output->data &&
+	    !blame_output_append(&state->output, output->data, output->size)) {
+		blame_output_free(&state->output);
+		state->capturing = FALSE;
+	}
+	blame_output_free(output);
+}
+
 static bool
 blame_detect_filename_display(struct view *view)
 {
@@ -92,7 +657,6 @@ blame_open(struct view *view, enum open_flags flags)
 	struct blame_state *state = view->private;
 	const char *file_argv[] = { repo.cdup, view->env->file , NULL };
 	char path[SIZEOF_STR];
-	size_t i;
 
 	if (is_initial_view(view)) {
 		/* Finish validating and setting up blame options */
@@ -132,24 +696,6 @@ blame_open(struct view *view, enum open_flags flags)
 			return FALSE;
 	}
 
-	/* First pass: remove multiple references to the same commit. */
-	for (i = 0; i < view->lines; i++) {
-		struct blame *blame = view->line[i].data;
-
-		if (blame->commit && blame->commit->id[0])
-			blame->commit->id[0] = 0;
-		else
-			blame->commit = NULL;
-	}
-
-	/* Second pass: free existing references. */
-	for (i = 0; i < view->lines; i++) {
-		struct blame *blame = view->line[i].data;
-
-		if (blame->commit)
-			free(blame->commit);
-	}
-
 	if (!(flags & OPEN_RELOAD))
 		reset_view_history(&blame_view_history);
 	string_copy_rev(state->history_state.id, view->env->ref);
@@ -180,8 +726,14 @@ get_blame_commit(struct view *view, const char *id)
 	{
 		struct blame_commit *commit = calloc(1, sizeof(*commit));
 
-		if (commit)
-			string_ncopy(commit->id, id, SIZEOF_REV);
+		if (!commit)
+			return NULL;
+		commit->info = get_commit_info(id);
+		if (!commit->info) {
+			free(commit);
+			return NULL;
+		}
+		string_ncopy(commit->id, id, SIZEOF_REV);
 		return commit;
 	}
 }
@@ -196,7 +748,7 @@ read_blame_commit(struct view *view, const char *text, struct blame_state *state
 	if (!parse_blame_header(&header, text, view->lines))
 		return NULL;
 
-	commit = get_blame_commit(view, text);
+	commit = get_blame_commit(view, header.id);
 	if (!commit)
 		return NULL;
 
@@ -213,23 +765,81 @@ read_blame_commit(struct view *view, const char *text, struct blame_state *state
 	return commit;
 }
 
+static bool
+blame_read_output(struct view *view, struct blame_state *state,
+		  struct blame_commit **commit, char *line)
+{
+	if (!*commit) {
+		*commit = read_blame_commit(view, line, state);
+		string_format(view->ref, "%s %2zd%%", view->vid,
+			      view->lines ? state->blamed * 100 / view->lines : 0);
+
+	} else if (parse_blame_info(*commit, line)) {
+		if (!(*commit)->filename)
+			return FALSE;
+		*commit = NULL;
+	}
+
+	return TRUE;
+}
+
 static bool
 blame_read_file(struct view *view, const char *text, struct blame_state *state)
 {
 	if (!text) {
+		char range[SIZEOF_STR];
 		const char *blame_argv[] = {
-			"git", "blame", encoding_arg, "%(blameargs)", "--incremental",
+			"git", "blame", encoding_arg, "%(blameargs)", "--incremental", range,
 				*view->env->ref ? view->env->ref : "--incremental", "--", view->env->file, NULL
 		};
+		const char *filename = state->history_state.filename;
+		struct blame_cache_entry *entry = NULL;
+		char args[SIZEOF_STR];
+		bool cacheable;
 
 		if (failed_to_load_initial_view(view))
 			die("No blame exist for %s", view->vid);
 
-		if (view->lines == 0 || !begin_update(view, repo.cdup, blame_argv, OPEN_EXTRA)) {
+		cacheable = view->lines && filename &&
+			    blame_cache_key(view->env->ref, args);
+		if (cacheable) {
+			entry = blame_cache_lookup(view->env->ref, filename, args);
+			if (!entry && blame_prefetch.running &&
+			    !strcmp(blame_prefetch.id, view->env->ref) &&
+			    blame_prefetch.filename == filename)
+				blame_stop_prefetch();
+		}
+
+		if (entry) {
+			io_done(view->pipe);
+			if (!io_from_string(view->pipe, entry->data)) {
+				report("Failed to load blame data");
+				return TRUE;
+			}
+
+		} else if (view->lines == 0) {
 			report("Failed to load blame data");
 			return TRUE;
+
+		} else {
+			size_t shards = blame_shard_count(view);
+
+			if (shards > 1 && blame_start_shards(view, shards))
+				string_format(range, "-L1,%zu", view->lines / shards);
+			else
+				string_copy(range, "--incremental");
+
+			if (!begin_update(view, repo.cdup, blame_argv, OPEN_EXTRA)) {
+				blame_stop_shards();
+				report("Failed to load blame data");
+				return TRUE;
+			}
 		}
 
+		/* Output is cached as read from git-blame. */
+		state->capturing = cacheable && !entry &&
+				   !view->encoding && !default_encoding;
+
 		if (view->env->lineno > 0) {
 			select_view_line(view, view->env->lineno);
 			view->env->lineno = 0;
@@ -261,6 +871,37 @@ blame_read(struct view *view, char *line)
 		return blame_read_file(view, line, state);
 
 	if (!line) {
+		struct blame_shard *shard = blame_next_shard(view);
+		size_t i;
+
+		/* Continue reading the next running shard through the view
+		 * pipe. Unless the pipe is done, the view is being aborted. */
+		if (shard && io_eof(view->pipe)) {
+			io_done(view->pipe);
+			*view->pipe = shard->io;
+			state->commit = shard->commit;
+			blame_capture_output(state, &shard->output);
+			shard->running = FALSE;
+			return FALSE;
+		}
+
+		for (i = 0; blame_shards.view == view && i < blame_shards.size; i++)
+			blame_capture_output(state, &blame_shards.shard[i].output);
+		if (blame_shards.view == view)
+			blame_stop_shards();
+
+		/* Only cache complete output, git-blame may have failed. */
+		if (state->capturing && state->output.data &&
+		    state->blamed == view->lines) {
+			char args[SIZEOF_STR];
+
+			if (blame_cache_key(view->env->ref, args))
+				blame_cache_store(view->env->ref, state->history_state.filename,
+						  args, &state->output);
+		}
+		blame_output_free(&state->output);
+		state->capturing = FALSE;
+
 		state->auto_filename_display = blame_detect_filename_display(view);
 		string_format(view->ref, "%s", view->vid);
 		if (view_is_displayed(view)) {
@@ -270,18 +911,102 @@ blame_read(struct view *view, char *line)
 		return TRUE;
 	}
 
-	if (!state->commit) {
-		state->commit = read_blame_commit(view, line, state);
-		string_format(view->ref, "%s %2zd%%", view->vid,
-			      view->lines ? state->blamed * 100 / view->lines : 0);
+	blame_capture_line(state, &state->output, line);
+	return blame_read_output(view, state, &state->commit, line);
+}
 
-	} else if (parse_blame_info(state->commit, line)) {
-		if (!state->commit->filename)
-			return FALSE;
-		state->commit = NULL;
+static void
+blame_read_shards(struct view *view)
+{
+	struct blame_state *state = view->private;
+	struct encoding *encoding = view->encoding ? view->encoding : default_encoding;
+	size_t i;
+
+	for (i = 0; i < blame_shards.size; i++) {
+		struct blame_shard *shard = &blame_shards.shard[i];
+		bool can_read = TRUE;
+		char *line;
+
+		if (!shard->running || !io_can_read(&shard->io, FALSE))
+			continue;
+
+		for (; (line = io_get(&shard->io, '\n', can_read)); can_read = FALSE) {
+			blame_capture_line(state, &shard->output, line);
+			if (encoding)
+				line = encoding_convert(encoding, line);
+			if (!blame_read_output(view, state, &shard->commit, line)) {
+				io_kill(&shard->io);
+				break;
+			}
+		}
+
+		if (line || io_eof(&shard->io) || io_error(&shard->io)) {
+			io_done(&shard->io);
+			shard->running = FALSE;
+		}
 	}
 
-	return TRUE;
+	if (view_is_displayed(view)) {
+		redraw_view_dirty(view);
+		update_view_title(view);
+	}
+}
+
+/* Read the output of the blame shards and the prefetch job and start a
+ * new prefetch job for the parent of the selected commit when the view
+ * is idle. Returns TRUE while a job is running. */
+static bool
+blame_poll(struct view *view)
+{
+	char buf[BUFSIZ];
+	char args[SIZEOF_STR];
+	struct blame *blame;
+	struct blame_commit *commit;
+	const char *filename;
+
+	if (blame_shards.view == view)
+		blame_read_shards(view);
+
+	if (blame_prefetch.running) {
+		ssize_t readsize;
+
+		if (!io_can_read(&blame_prefetch.io, FALSE))
+			return TRUE;
+
+		readsize = io_read(&blame_prefetch.io, buf, sizeof(buf));
+		if (readsize > 0) {
+			if (blame_output_append(&blame_prefetch.output, buf, readsize))
+				return TRUE;
+			io_kill(&blame_prefetch.io);
+		}
+
+		blame_prefetch.running = FALSE;
+		if (io_done(&blame_prefetch.io) && readsize == 0 &&
+		    blame_prefetch.output.data)
+			blame_cache_store(blame_prefetch.id, blame_prefetch.filename,
+					blame_prefetch.args, &blame_prefetch.output);
+		blame_output_free(&blame_prefetch.output);
+	}
+
+	if (view->pipe || !view_is_displayed(view) || !view->lines)
+		return FALSE;
+
+	blame = view->line[view->pos.lineno].data;
+	commit = blame->commit;
+	if (!commit || !commit->filename || !*commit->parent_id ||
+	    !commit->parent_filename ||
+	    !blame_cache_key(commit->parent_id, args))
+		return FALSE;
+
+	/* Do not retry the last job if it failed. */
+	filename = commit->parent_filename;
+	if ((!strcmp(blame_prefetch.id, commit->parent_id) &&
+	     blame_prefetch.filename == filename &&
+	     !strcmp(blame_prefetch.args, args)) ||
+	    blame_cache_lookup(commit->parent_id, filename, args))
+		return FALSE;
+
+	return blame_start_prefetch(view, commit->parent_id, filename, args);
 }
 
 static bool
@@ -308,9 +1033,9 @@ blame_draw(struct view *view, struct line *line, unsigned int lineno)
 
 	if (blame->commit && blame->commit->filename) {
 		id = blame->commit->id;
-		author = blame->commit->author;
+		author = blame->commit->info->author;
 		filename = blame->commit->filename;
-		time = &blame->commit->time;
+		time = &blame->commit->info->time;
 		id_type = BLAME_COLOR((long) blame->commit);
 	}
 
@@ -496,16 +1221,42 @@ blame_grep(struct view *view, struct line *line)
 	struct blame_commit *commit = blame->commit;
 	const char *text[] = {
 		blame->text,
-		commit ? commit->title : "",
+		commit && commit->info->title ? commit->info->title : "",
 		commit ? commit->id : "",
-		commit ? mkauthor(commit->author, opt_author_width, opt_show_author) : "",
-		commit ? mkdate(&commit->time, opt_show_date) : "",
+		commit ? mkauthor(commit->info->author, opt_author_width, opt_show_author) : "",
+		commit ? mkdate(&commit->info->time, opt_show_date) : "",
 		NULL
 	};
 
 	return grep_text(view, text);
 }
 
+static void
+blame_done(struct view *view)
+{
+	size_t i;
+
+	/* First pass: remove multiple references to the same commit. */
+	for (i = 0; i < view->lines; i++) {
+		struct blame *blame = view->line[i].data;
+
+		if (blame->commit && blame->commit->id[0])
+			blame->commit->id[0] = 0;
+		else
+			blame->commit = NULL;
+	}
+
+	/* Second pass: free existing references. */
+	for (i = 0; i < view->lines; i++) {
+		struct blame *blame = view->line[i].data;
+
+		if (blame->commit) {
+			put_commit_info(blame->commit->info);
+			free(blame->commit);
+		}
+	}
+}
+
 static void
 blame_select(struct view *view, struct line *line)
 {
@@ -533,6 +1284,8 @@ struct view_ops blame_ops = {
 	blame_request,
 	blame_grep,
 	blame_select,
+	blame_done,
+	blame_poll,
 };
 
 /* vim: set ts=8 sw=8 noexpandtab: */
@@ -0,0 +1,205 @@
+/* Generated by tools/make-builtin-config.sh on Mon Oct 19 19:15:35 UTC 2026 */
+const char *builtin_config =
+	"set show-date	= default\n"
+	"set show-author	= full\n"
+	"set author-width	= 18\n"
+	"set show-filename	= auto\n"
+	"set filename-width	= 18\n"
+	"set show-file-size	= default\n"
+	"set show-rev-graph	= yes\n"
+	"set show-line-numbers	= no\n"
+	"set line-number-interval	= 5\n"
+	"set show-refs	= yes\n"
+	"set show-changes	= yes\n"
+	"set show-id	= no\n"
+	"set id-width	= 7\n"
+	"set title-overflow	= no\n"
+	"set wrap-lines	= no\n"
+	"set tab-size	= 8\n"
+	"set line-graphics	= default\n"
+	"set commit-order	= default\n"
+	"set status-untracked-dirs	= yes\n"
+	"set watch-worktree	= no\n"
+	"set blame-cache	= no\n"
+	"set ignore-space	= no\n"
+	"set show-notes	= yes\n"
+	"set diff-context	= 3\n"
+	"set diff-lazy-threshold	= 0\n"
+	"set read-git-colors	= yes\n"
+	"set ignore-case	= no\n"
+	"set focus-child	= yes\n"
+	"set horizontal-scroll	= 50%\n"
+	"set split-view-height	= 67%\n"
+	"set vertical-split	= auto\n"
+	"set editor-line-number	= yes\n"
+	"set mouse	= no\n"
+	"set mouse-scroll	= 3\n"
+	"set frame-rate	= 60\n"
+	"bind main	C	?git cherry-pick %(commit)\n"
+	"bind status	C	!git commit\n"
+	"bind stash	P	?git stash pop %(stash)\n"
+	"bind branch	C	?git checkout %(branch)\n"
+	"bind generic	m	view-main\n"
+	"bind generic	d	view-diff\n"
+	"bind generic	l	view-log\n"
+	"bind generic	t	view-tree\n"
+	"bind generic	f	view-blob\n"
+	"bind generic	B	view-blame\n"
+	"bind generic	H	view-branch\n"
+	"bind generic	p	view-pager\n"
+	"bind generic	h	view-help\n"
+	"bind generic	S	view-status\n"
+	"bind generic	c	view-stage\n"
+	"bind generic	y	view-stash\n"
+	"bind generic	G	view-grep\n"
+	"bind generic	Enter	enter\n"
+	"bind generic	<	back\n"
+	"bind generic	Down	next\n"
+	"bind generic	^N	next\n"
+	"bind generic	Up	previous\n"
+	"bind generic	^P	previous\n"
+	"bind generic	,	parent\n"
+	"bind generic	Tab	view-next\n"
+	"bind generic	R	refresh\n"
+	"bind generic	F5	refresh\n"
+	"bind generic	O	maximize\n"
+	"bind generic	q	view-close\n"
+	"bind generic	Q	quit\n"
+	"bind status	u	status-update\n"
+	"bind status	!	status-revert\n"
+	"bind status	M	status-merge\n"
+	"bind stage	u	status-update\n"
+	"bind stage	1	stage-update-line\n"
+	"bind stage	!	status-revert\n"
+	"bind stage	@	stage-next\n"
+	"bind stage	\\	stage-split-chunk\n"
+	"bind stage	V	stage-select-range\n"
+	"bind stage	[	diff-context-down\n"
+	"bind stage	]	diff-context-up\n"
+	"bind diff	[	diff-context-down\n"
+	"bind diff	]	diff-context-up\n"
+	"bind generic	k	move-up\n"
+	"bind generic	j	move-down\n"
+	"bind generic	PgDown	move-page-down\n"
+	"bind generic	^D	move-page-down\n"
+	"bind generic	Space	move-page-down\n"
+	"bind generic	PgUp	move-page-up\n"
+	"bind generic	^U	move-page-up\n"
+	"bind generic	b	move-page-up\n"
+	"bind generic	-	move-page-up\n"
+	"bind generic	Home	move-first-line\n"
+	"bind generic	End	move-last-line\n"
+	"bind generic	|	scroll-first-col\n"
+	"bind generic	Left	scroll-left\n"
+	"bind generic	Right	scroll-right\n"
+	"bind generic	Insert	scroll-line-up\n"
+	"bind generic	^Y	scroll-line-up\n"
+	"bind generic	Delete	scroll-line-down\n"
+	"bind generic	^E	scroll-line-down\n"
+	"bind generic	w	scroll-page-up\n"
+	"bind generic	s	scroll-page-down\n"
+	"bind generic	/	search\n"
+	"bind generic	?	search-back\n"
+	"bind generic	n	find-next\n"
+	"bind generic	N	find-prev\n"
+	"bind generic	o	options\n"
+	"bind generic	.	toggle-lineno\n"
+	"bind generic	D	toggle-date\n"
+	"bind generic	A	toggle-author\n"
+	"bind generic	g	toggle-rev-graph\n"
+	"bind generic	~	toggle-graphic\n"
+	"bind generic	Hash	toggle-filename\n"
+	"bind generic	F	toggle-refs\n"
+	"bind generic	I	toggle-sort-order\n"
+	"bind generic	i	toggle-sort-field\n"
+	"bind generic	W	toggle-ignore-space\n"
+	"bind generic	X	toggle-id\n"
+	"bind generic	%	toggle-files\n"
+	"bind generic	$	toggle-title-overflow\n"
+	"bind generic	e	edit\n"
+	"bind generic	:	prompt\n"
+	"bind generic	r	screen-redraw\n"
+	"bind generic	^L	screen-redraw\n"
+	"bind generic	z	stop-loading\n"
+	"bind generic	v	show-version\n"
+	"color \"diff --\"	yellow	default\n"
+	"color \"@@\"	magenta	default\n"
+	"color \"+\"	green	default\n"
+	"color \" +\"	green	default\n"
+	"color \"-\"	red	default\n"
+	"color \" -\"	red	default\n"
+	"color \"index \"	blue	default\n"
+	"color \"old file mode \"	yellow	default\n"
+	"color \"new file mode \"	yellow	default\n"
+	"color \"deleted file mode \"	yellow	default\n"
+	"color \"copy from \"	yellow	default\n"
+	"color \"copy to \"	yellow	default\n"
+	"color \"rename from \"	yellow	default\n"
+	"color \"rename to \"	yellow	default\n"
+	"color \"similarity \"	yellow	default\n"
+	"color \"dissimilarity \"	yellow	default\n"
+	"color \"diff-tree \"	blue	default\n"
+	"color \"Author: \"	cyan	default\n"
+	"color \"Commit: \"	magenta	default\n"
+	"color \"Merge: \"	blue	default\n"
+	"color \"Date: \"	yellow	default\n"
+	"color \"AuthorDate: \"	yellow	default\n"
+	"color \"CommitDate: \"	yellow	default\n"
+	"color \"Refs: \"	red	default\n"
+	"color \"Reflog: \"	red	default\n"
+	"color \"Reflog message: \"	yellow	default\n"
+	"color \"stash@{\"	magenta	default\n"
+	"color \"commit \"	green	default\n"
+	"color \"parent \"	blue	default\n"
+	"color \"tree \"	blue	default\n"
+	"color \"author \"	green	default\n"
+	"color \"committer \"	magenta	default\n"
+	"color \"    Signed-off-by\"	yellow	default\n"
+	"color \"    Acked-by\"	yellow	default\n"
+	"color \"    Tested-by\"	yellow	default\n"
+	"color \"    Reviewed-by\"	yellow	default\n"
+	"color default	default	default	normal\n"
+	"color cursor	white	green	bold\n"
+	"color status	green	default\n"
+	"color delimiter	magenta	default\n"
+	"color date	blue	default\n"
+	"color mode	cyan	default\n"
+	"color id	magenta	default\n"
+	"color overflow	red	default\n"
+	"color filename	default	default\n"
+	"color grep.filename	blue	default\n"
+	"color file-size	default	default\n"
+	"color line-number	cyan	default\n"
+	"color search-result	black	yellow\n"
+	"color title-blur	white	blue\n"
+	"color title-focus	white	blue	bold\n"
+	"color main-commit	default	default\n"
+	"color main-tag	magenta	default	bold\n"
+	"color main-local-tag	magenta	default\n"
+	"color main-remote	yellow	default\n"
+	"color main-replace	cyan	default\n"
+	"color main-tracked	yellow	default	bold\n"
+	"color main-ref	cyan	default\n"
+	"color main-head	cyan	default	bold\n"
+	"color main-revgraph	magenta	default\n"
+	"color tree-head	default	default	bold\n"
+	"color tree-dir	yellow	default	normal\n"
+	"color tree-file	default	default	normal\n"
+	"color stat-head	yellow	default\n"
+	"color stat-section	cyan	default\n"
+	"color stat-none	default	default\n"
+	"color stat-staged	magenta	default\n"
+	"color stat-unstaged	magenta	default\n"
+	"color stat-untracked	magenta	default\n"
+	"color help-keymap	cyan	default\n"
+	"color help-group	blue	default\n"
+	"color diff-stat	blue	default\n"
+	"color palette-0	magenta	default\n"
+	"color palette-1	yellow	default\n"
+	"color palette-2	cyan	default\n"
+	"color palette-3	green	default\n"
+	"color palette-4	default	default\n"
+	"color palette-5	white	default\n"
+	"color palette-6	red	default\n"
+	"color graph-commit	blue	default\n"
+;
@@ -49,6 +49,143 @@ update_diff_context(enum request request)
 }
 
 #define DIFF_LINE_COMMIT_TITLE 1
+#define DIFF_LINE_LAZY		2
+
+/*
+ * Diff index.
+ */
+
+DEFINE_ALLOCATOR(realloc_diff_index, unsigned long, 1024)
+
+static void
+diff_index_add(struct diff_index *index, unsigned long **entries, size_t *size, unsigned long pos)
+{
+	if (!index->valid)
+		return;
+	if (!realloc_diff_index(entries, *size, 1)) {
+		index->valid = FALSE;
+		return;
+	}
+	(*entries)[(*size)++] = pos;
+}
+
+/* Returns the position of the first entry at or after pos. */
+static size_t
+diff_index_search(const unsigned long *entries, size_t size, unsigned long pos)
+{
+	size_t low = 0, high = size;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (entries[mid] < pos)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static void
+diff_index_reverse(unsigned long *entries, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size / 2; i++) {
+		unsigned long entry = entries[i];
+
+		entries[i] = entries[size - i - 1];
+		entries[size - i - 1] = entry;
+	}
+}
+
+/* Update the entries after the lines from the given position to the end of
+ * the view have been moved to start at another position. */
+static void
+diff_index_move(unsigned long *entries, size_t size, unsigned long to, unsigned long from, unsigned long lines)
+{
+	size_t first = diff_index_search(entries, size, to);
+	size_t moved = diff_index_search(entries, size, from);
+	size_t i;
+
+	for (i = first; i < moved; i++)
+		entries[i] += lines;
+	for (i = moved; i < size; i++)
+		entries[i] = entries[i] - from + to;
+
+	/* Rotate the moved entries in front of the shifted ones. */
+	diff_index_reverse(entries + first, moved - first);
+	diff_index_reverse(entries + moved, size - moved);
+	diff_index_reverse(entries + first, size - first);
+}
+
+void
+diff_common_done(struct diff_state *state)
+{
+	struct diff_index *index = &state->index;
+
+	free(index->header);
+	free(index->chunk);
+	free(index->file);
+	free(index->stat);
+	memset(index, 0, sizeof(*index));
+}
+
+struct line *
+diff_find_line_by_type(struct view *view, struct line *line, enum line_type type, int direction)
+{
+	struct diff_state *state = view->private;
+	struct diff_index *index = &state->index;
+	unsigned long *entries = type == LINE_DIFF_HEADER ? index->header : index->chunk;
+	size_t size = type == LINE_DIFF_HEADER ? index->headers : index->chunks;
+	unsigned long pos = line - view->line;
+	size_t i;
+
+	if (!index->valid || (type != LINE_DIFF_HEADER && type != LINE_DIFF_CHUNK))
+		return find_line_by_type(view, line, type, direction);
+
+	if (!view_has_line(view, line))
+		return NULL;
+
+	i = diff_index_search(entries, size, pos);
+	if (direction > 0)
+		return i < size ? &view->line[entries[i]] : NULL;
+	if (i < size && entries[i] == pos)
+		return line;
+	return i > 0 ? &view->line[entries[i - 1]] : NULL;
+}
+
+/* Whether a file header continues the diff of the file before it. Without
+ * rename detection a type change is shown as a deletion followed by an
+ * addition of the same file, which has a single diffstat entry. */
+static bool
+diff_same_file(struct line *header, struct line *prev)
+{
+	return prev && !strcmp(header->data, prev->data);
+}
+
+/* Find the file header of a diffstat entry, which is the header of the
+ * file with the same number counting only files with an index or
+ * similarity line. */
+static struct line *
+diff_find_stat_header(struct view *view, struct line *line)
+{
+	struct diff_state *state = view->private;
+	struct diff_index *index = &state->index;
+	unsigned long pos = line - view->line;
+	size_t i;
+
+	if (!index->valid)
+		return NULL;
+
+	i = diff_index_search(index->stat, index->stats, pos + 1);
+	if (!i)
+		return NULL;
+
+	pos -= index->stat[i - 1];
+	return pos < index->files ? &view->line[index->file[pos]] : NULL;
+}
 
 static bool
 diff_open(struct view *view, enum open_flags flags)
@@ -60,15 +197,373 @@ diff_open(struct view *view, enum open_flags flags)
 			"%(diffargs)", "%(cmdlineargs)", "--no-color", "%(commit)",
 			"--", "%(fileargs)", NULL
 	};
+	static const char *diff_stat_argv[] = {
+		"git", "show", encoding_arg, "--pretty=fuller", "--root",
+			"--stat", opt_notes_arg, opt_ignore_space_arg,
+			"%(diffargs)", "--no-color", "%(commit)",
+			"--", "%(fileargs)", NULL
+	};
+	struct diff_state *state = view->private;
+	bool lazy = opt_diff_lazy_threshold > 0 && !opt_cmdline_argv;
+
+	if (!begin_update(view, NULL, lazy ? diff_stat_argv : diff_argv, flags))
+		return FALSE;
 
-	return begin_update(view, NULL, diff_argv, flags);
+	state->reading_lazy_stat = lazy && view->pipe;
+	return TRUE;
+}
+
+/*
+ * Lazy loading of large diffs.
+ *
+ * When the diffstat reports more changed lines than the diff-lazy-threshold
+ * option, only the commit message, the diffstat and a header line for each
+ * file are loaded. The changes to a file are loaded when its header comes
+ * into view. The data of a header line which has not been loaded yet holds
+ * the old and new path after the header text.
+ */
+
+static bool
+diff_lazy_argv(struct view *view, const char ***argv, const char *prefix_argv[])
+{
+	char id[SIZEOF_REV];
+
+	/* The view may have been opened with revision arguments, so name
+	 * the commit it shows. */
+	if (view->lines && view->line[0].type == LINE_COMMIT)
+		string_copy_rev_from_commit_line(id, view->line[0].data);
+	else
+		string_ncopy(id, view->vid, strlen(view->vid));
+
+	if (!argv_format(view->env, argv, prefix_argv, FALSE, FALSE) ||
+	    !argv_append(argv, id) ||
+	    !argv_append(argv, "--")) {
+		argv_free(*argv);
+		free(*argv);
+		*argv = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+diff_lazy_parse_changes(struct diff_state *state, const char *data)
+{
+	const char *pos = strstr(data, " changed, ");
+
+	if (data[0] != ' ' || !isdigit(data[1]) || !pos)
+		return;
+
+	while ((pos = strchr(pos, ','))) {
+		pos += STRING_SIZE(", ");
+		state->changes += strtoul(pos, NULL, 10);
+	}
+}
+
+static bool
+diff_lazy_add_file(struct view *view, const char *old_name, const char *new_name)
+{
+	struct diff_state *state = view->private;
+	size_t old_len = strlen(old_name);
+	size_t new_len = strlen(new_name);
+	size_t header_len = STRING_SIZE("diff --git a/ b/") + old_len + new_len;
+	struct line *line;
+	char *data;
+
+	line = add_line(view, NULL, LINE_DIFF_HEADER, header_len + old_len + new_len + 3, FALSE);
+	if (!line)
+		return FALSE;
+
+	data = line->data;
+	sprintf(data, "diff --git a/%s b/%s", old_name, new_name);
+	strcpy(data + header_len + 1, old_name);
+	strcpy(data + header_len + 1 + old_len + 1, new_name);
+	line->user_flags |= DIFF_LINE_LAZY;
+	diff_index_add(&state->index, &state->index.header, &state->index.headers, line - view->line);
+	diff_index_add(&state->index, &state->index.file, &state->index.files, line - view->line);
+	return TRUE;
+}
+
+static bool
+diff_lazy_read_files(struct view *view)
+{
+	static const char *names_argv[] = {
+		"git", "show", "--pretty=format:", "--root", "--name-status", "-z",
+			"%(diffargs)", NULL
+	};
+	const char **argv = NULL;
+	struct io io;
+	char *status;
+	bool ok = TRUE;
+
+	if (!diff_lazy_argv(view, &argv, names_argv))
+		return FALSE;
+	if (opt_file_argv && !argv_append_array(&argv, opt_file_argv))
+		ok = FALSE;
+
+	if (ok && io_run(&io, IO_RD, repo.cdup, opt_env, argv)) {
+		if (view->lines && *(char *) view->line[view->lines - 1].data)
+			add_line_text(view, "", LINE_DEFAULT);
+
+		while (ok && (status = io_get(&io, '\0', TRUE))) {
+			char old_name[SIZEOF_STR];
+			char *new_name;
+
+			if (!*status)
+				continue;
+
+			if (*status == 'R' || *status == 'C') {
+				char *name = io_get(&io, '\0', TRUE);
+
+				if (!name)
+					break;
+				string_ncopy(old_name, name, strlen(name));
+			}
+
+			new_name = io_get(&io, '\0', TRUE);
+			if (!new_name)
+				break;
+			if (*status != 'R' && *status != 'C')
+				string_ncopy(old_name, new_name, strlen(new_name));
+
+			ok = diff_lazy_add_file(view, old_name, new_name);
+		}
+
+		if (io_error(&io))
+			ok = FALSE;
+		io_done(&io);
+	} else {
+		ok = FALSE;
+	}
+
+	argv_free(argv);
+	free(argv);
+	return ok;
+}
+
+static bool
+diff_lazy_read_patch(struct view *view)
+{
+	static const char *patch_argv[] = {
+		"git", "show", encoding_arg, "--pretty=format:", "--root", "--patch",
+			opt_diff_context_arg, opt_ignore_space_arg, "%(diffargs)",
+			"--no-color", NULL
+	};
+	const char **argv = NULL;
+	bool ok;
+
+	if (!diff_lazy_argv(view, &argv, patch_argv))
+		return FALSE;
+
+	ok = (!opt_file_argv || argv_append_array(&argv, opt_file_argv)) &&
+	     add_line_text(view, "", LINE_DEFAULT);
+	if (ok) {
+		io_done(view->pipe);
+		ok = io_run(&view->io, IO_RD, view->dir, opt_env, argv);
+	}
+
+	argv_free(argv);
+	free(argv);
+	return ok;
+}
+
+/* Move the lines from the given position to the end of the view to start at
+ * another position and renumber the lines following it. */
+static bool
+diff_lazy_move_lines(struct view *view, size_t to, size_t from)
+{
+	struct diff_state *state = view->private;
+	struct diff_index *index = &state->index;
+	size_t size = view->lines - from;
+	struct line *moved = calloc(size, sizeof(*moved));
+	unsigned int lineno;
+
+	if (!moved)
+		return FALSE;
+
+	memcpy(moved, view->line + from, size * sizeof(*moved));
+	memmove(view->line + to + size, view->line + to, (from - to) * sizeof(*moved));
+	memcpy(view->line + to, moved, size * sizeof(*moved));
+	free(moved);
+
+	diff_index_move(index->header, index->headers, to, from, size);
+	diff_index_move(index->chunk, index->chunks, to, from, size);
+	diff_index_move(index->file, index->files, to, from, size);
+	diff_index_move(index->stat, index->stats, to, from, size);
+	reset_search_results(view);
+
+	for (lineno = view->line[to - 1].lineno; to < view->lines; to++) {
+		if (!view->line[to].wrapped)
+			lineno++;
+		view->line[to].lineno = lineno;
+		view->line[to].dirty = 1;
+	}
+
+	return TRUE;
+}
+
+/* Background loading of the changes to a lazily loaded file. The lines are
+ * moved in place after the file header as they are read. */
+static struct {
+	struct view *view;
+	struct io io;
+	struct diff_state state;	/* Read state of the file diff. */
+	size_t pos;			/* Where to move the next lines. */
+	bool has_lines;			/* Whether any line has been read. */
+} diff_lazy;
+
+static void
+diff_lazy_stop_load(void)
+{
+	if (diff_lazy.view) {
+		io_kill(&diff_lazy.io);
+		io_done(&diff_lazy.io);
+	}
+
+	memset(&diff_lazy, 0, sizeof(diff_lazy));
+}
+
+static bool
+diff_lazy_start_load(struct view *view, struct line *line)
+{
+	static const char *file_argv[] = {
+		"git", "--literal-pathspecs", "show", encoding_arg, "--pretty=format:",
+			"--root", "--patch", opt_diff_context_arg, opt_ignore_space_arg,
+			"%(diffargs)", "--no-color", NULL
+	};
+	const char *header = line->data;
+	const char *old_name = header + strlen(header) + 1;
+	const char *new_name = old_name + strlen(old_name) + 1;
+	size_t pos = line - view->line;
+	const char **argv = NULL;
+	bool ok;
+
+	line->user_flags &= ~DIFF_LINE_LAZY;
+
+	ok = diff_lazy_argv(view, &argv, file_argv) &&
+	     argv_append(&argv, old_name) &&
+	     (!strcmp(old_name, new_name) || argv_append(&argv, new_name)) &&
+	     io_run(&diff_lazy.io, IO_RD, repo.cdup, opt_env, argv);
+	argv_free(argv);
+	free(argv);
+	if (!ok)
+		return FALSE;
+
+	for (pos++; pos < view->lines && view->line[pos].wrapped; pos++)
+		;
+
+	diff_lazy.view = view;
+	diff_lazy.state.after_commit_title = TRUE;
+	diff_lazy.state.after_diff = TRUE;
+	diff_lazy.pos = pos;
+	return TRUE;
+}
+
+/* Read the lines available without blocking and move them in place. */
+static bool
+diff_lazy_read_file(struct view *view)
+{
+	struct diff_state *view_state = view->private;
+	size_t from = view->lines;
+	bool can_read = TRUE;
+	bool ok = TRUE;
+	char *data;
+
+	diff_lazy.state.index = view_state->index;
+	for (; (data = io_get(&diff_lazy.io, '\n', can_read)); can_read = FALSE) {
+		if (!diff_lazy.has_lines) {
+			diff_lazy.has_lines = TRUE;
+			/* The file header is already in the view. */
+			if (get_line_type(data) == LINE_DIFF_HEADER)
+				continue;
+		}
+		if (!diff_common_read(view, data, &diff_lazy.state)) {
+			ok = FALSE;
+			break;
+		}
+	}
+	/* The file was added to the index with the list of changed files. */
+	diff_lazy.state.index.files = view_state->index.files;
+	view_state->index = diff_lazy.state.index;
+
+	if (ok && view->lines > from && diff_lazy.pos < from) {
+		ok = diff_lazy_move_lines(view, diff_lazy.pos, from);
+
+		/* Keep the cursor on the same line. */
+		if (ok && diff_lazy.pos <= view->pos.lineno) {
+			view->pos.lineno += view->lines - from;
+			view->pos.offset += view->lines - from;
+		}
+	}
+
+	if (!ok) {
+		while (view->lines > from)
+			free(view->line[--view->lines].data);
+		view_state->index.valid = FALSE;
+		return FALSE;
+	}
+
+	diff_lazy.pos += view->lines - from;
+	return TRUE;
+}
+
+static bool
+diff_poll(struct view *view)
+{
+	unsigned long lineno, end;
+
+	if (diff_lazy.view == view) {
+		bool ok;
+
+		if (!io_can_read(&diff_lazy.io, FALSE))
+			return TRUE;
+
+		ok = diff_lazy_read_file(view);
+		if (!ok || io_eof(&diff_lazy.io) || io_error(&diff_lazy.io)) {
+			if (!ok || io_error(&diff_lazy.io))
+				report("Failed to load the file diff");
+			diff_lazy_stop_load();
+		}
+
+		/* Keep loading when the view is hidden but leave its window
+		 * alone. */
+		if (view_is_displayed(view)) {
+			redraw_view(view);
+			update_view_title(view);
+		}
+		return TRUE;
+	}
+
+	/* Only load files which are on screen. */
+	if (view->pipe || !view_is_displayed(view) || !view->height || diff_lazy.view)
+		return FALSE;
+
+	/* Load the files which are in view or on the next page. */
+	end = MIN(view->lines, view->pos.offset + view->height * 2);
+	for (lineno = view->pos.offset; lineno < end; lineno++) {
+		struct line *line = &view->line[lineno];
+
+		if (line->user_flags & DIFF_LINE_LAZY) {
+			if (!diff_lazy_start_load(view, line))
+				report("Failed to load the file diff");
+			return TRUE;
+		}
+	}
+
+	return FALSE;
 }
 
 bool
 diff_common_read(struct view *view, const char *data, struct diff_state *state)
 {
+	struct diff_index *index = &state->index;
+	unsigned long pos = view->lines;
 	enum line_type type = get_line_type(data);
 
+	if (!view->lines)
+		index->valid = TRUE;
+
 	if (!view->lines && type != LINE_COMMIT)
 		state->reading_diff_stat = TRUE;
 
@@ -84,6 +579,9 @@ diff_common_read(struct view *view, const char *data, struct diff_state *state)
 		bool has_no_change = pipe && strstr(pipe, " 0");
 
 		if (pipe && (has_histogram || has_bin_diff || has_rename || has_no_change)) {
+			if (!index->stats || index->last_stat + 1 != pos)
+				diff_index_add(index, &index->stat, &index->stats, pos);
+			index->last_stat = pos;
 			return add_line_text(view, data, LINE_DIFF_STAT) != NULL;
 		} else {
 			state->reading_diff_stat = FALSE;
@@ -118,7 +616,24 @@ diff_common_read(struct view *view, const char *data, struct diff_state *state)
 	if (!state->combined_diff && (type == LINE_DIFF_ADD2 || type == LINE_DIFF_DEL2))
 		type = LINE_DEFAULT;
 
-	return pager_common_read(view, data, type);
+	if (!pager_common_read(view, data, type))
+		return FALSE;
+
+	if (type == LINE_DIFF_HEADER) {
+		diff_index_add(index, &index->header, &index->headers, pos);
+
+	} else if (type == LINE_DIFF_CHUNK) {
+		diff_index_add(index, &index->chunk, &index->chunks, pos);
+
+	} else if ((type == LINE_DIFF_INDEX || type == LINE_DIFF_SIMILARITY) && index->headers) {
+		unsigned long header = index->header[index->headers - 1];
+		struct line *file = index->files ? &view->line[index->file[index->files - 1]] : NULL;
+
+		if (!diff_same_file(&view->line[header], file))
+			diff_index_add(index, &index->file, &index->files, header);
+	}
+
+	return TRUE;
 }
 
 static bool
@@ -134,8 +649,16 @@ enum request
 diff_common_enter(struct view *view, enum request request, struct line *line)
 {
 	if (line->type == LINE_DIFF_STAT) {
+		struct line *header = diff_find_stat_header(view, line);
+		struct line *file = NULL;
 		int file_number = 0;
 
+		if (header) {
+			select_view_line(view, header - view->line);
+			report_clear();
+			return REQ_NONE;
+		}
+
 		while (view_has_line(view, line) && line->type == LINE_DIFF_STAT) {
 			file_number++;
 			line--;
@@ -146,12 +669,15 @@ diff_common_enter(struct view *view, enum request request, struct line *line)
 			if (!line)
 				break;
 
-			if (diff_find_stat_entry(view, line, LINE_DIFF_INDEX)
-			    || diff_find_stat_entry(view, line, LINE_DIFF_SIMILARITY)) {
+			if (((line->user_flags & DIFF_LINE_LAZY)
+			     || diff_find_stat_entry(view, line, LINE_DIFF_INDEX)
+			     || diff_find_stat_entry(view, line, LINE_DIFF_SIMILARITY))
+			    && !diff_same_file(line, file)) {
 				if (file_number == 1) {
 					break;
 				}
 				file_number--;
+				file = line;
 			}
 		}
 
@@ -224,6 +750,23 @@ diff_read(struct view *view, char *data)
 {
 	struct diff_state *state = view->private;
 
+	if (state->reading_lazy_stat) {
+		if (data) {
+			/* Unlike --patch-with-stat, a blank line separates
+			 * the commit message and the diffstat. */
+			if (data[0] == ' ' && data[1] != ' ')
+				state->reading_diff_stat = TRUE;
+			diff_lazy_parse_changes(state, data);
+
+		} else if (view->lines) {
+			state->reading_lazy_stat = FALSE;
+			if (state->combined_diff || state->changes <= opt_diff_lazy_threshold)
+				return !diff_lazy_read_patch(view);
+			if (!diff_lazy_read_files(view))
+				report("Failed to read the changed files");
+		}
+	}
+
 	if (!data) {
 		/* Fall back to retry if no diff will be shown. */
 		if (view->lines == 0 && opt_file_argv) {
@@ -293,8 +836,8 @@ diff_get_lineno(struct view *view, struct line *line)
 	struct chunk_header chunk_header;
 
 	/* Verify that we are after a diff header and one of its chunks */
-	header = find_prev_line_by_type(view, line, LINE_DIFF_HEADER);
-	chunk = find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
+	header = diff_find_prev_line_by_type(view, line, LINE_DIFF_HEADER);
+	chunk = diff_find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
 	if (!header || !chunk || chunk < header)
 		return 0;
 
@@ -319,15 +862,15 @@ diff_get_lineno(struct view *view, struct line *line)
 static enum request
 diff_trace_origin(struct view *view, struct line *line)
 {
-	struct line *diff = find_prev_line_by_type(view, line, LINE_DIFF_HEADER);
-	struct line *chunk = find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
+	struct line *diff = diff_find_prev_line_by_type(view, line, LINE_DIFF_HEADER);
+	struct line *chunk = diff_find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
 	const char *chunk_data;
 	int chunk_marker = line->type == LINE_DIFF_DEL ? '-' : '+';
 	unsigned long lineno = 0;
 	const char *file = NULL;
 	char ref[SIZEOF_REF];
 	struct blame_header header;
-	struct blame_commit commit;
+	struct blame_commit commit = {};
 
 	if (!diff || !chunk || chunk == line) {
 		report("The line to trace must be inside a diff chunk");
@@ -395,7 +938,7 @@ diff_get_pathname(struct view *view, struct line *line)
 	const char *prefixes[] = { " b/", "cc ", "combined " };
 	int i;
 
-	header = find_prev_line_by_type(view, line, LINE_DIFF_HEADER);
+	header = diff_find_prev_line_by_type(view, line, LINE_DIFF_HEADER);
 	if (!header)
 		return NULL;
 
@@ -474,6 +1017,14 @@ diff_select(struct view *view, struct line *line)
 	}
 }
 
+static void
+diff_done(struct view *view)
+{
+	if (diff_lazy.view == view)
+		diff_lazy_stop_load();
+	diff_common_done(view->private);
+}
+
 struct view_ops diff_ops = {
 	"line",
 	{ "diff" },
@@ -486,6 +1037,8 @@ struct view_ops diff_ops = {
 	diff_request,
 	pager_grep,
 	diff_select,
+	diff_done,
+	diff_poll,
 };
 
 /* vim: set ts=8 sw=8 noexpandtab: */
@@ -19,6 +19,7 @@
 #include "tig/view.h"
 #include "tig/draw.h"
 #include "tig/display.h"
+#include "tig/pager.h"
 
 struct view *display[2];
 unsigned int current_view;
@@ -206,6 +207,7 @@ resize_display(void)
 
 		view->win = display_win[i];
 		view->title = display_title[i];
+		pager_rewrap_view(view);
 
 		if (vsplit)
 			x += view->width + 1;
@@ -375,6 +377,26 @@ init_display(void)
 	}
 }
 
+/* Whether to refresh the screen while views are loading. Updates are
+ * collected in the virtual screen and flushed once per frame. */
+static bool
+update_frame_is_due(void)
+{
+	static struct timeval last_update;
+	struct timeval now;
+	long usecs;
+
+	if (opt_frame_rate <= 0 || gettimeofday(&now, NULL))
+		return TRUE;
+
+	usecs = (now.tv_sec - last_update.tv_sec) * 1000000 + now.tv_usec - last_update.tv_usec;
+	if (usecs >= 0 && usecs < 1000000 / opt_frame_rate)
+		return FALSE;
+
+	last_update = now;
+	return TRUE;
+}
+
 int
 get_input(int prompt_position)
 {
@@ -393,7 +415,8 @@ get_input(int prompt_position)
 			    use_scroll_redrawwin)
 				redrawwin(view->win);
 			view->has_scrolled = FALSE;
-			if (view->pipe)
+			if ((view->ops->poll && view->ops->poll(view)) ||
+			    update_search(view) || view->pipe)
 				loading = TRUE;
 		}
 
@@ -410,7 +433,8 @@ get_input(int prompt_position)
 		setsyx(cursor_y, cursor_x);
 
 		/* Refresh, accept single keystroke of input */
-		doupdate();
+		if (!loading || update_frame_is_due())
+			doupdate();
 		nodelay(status_win, loading);
 		key = wgetch(status_win);
 
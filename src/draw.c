@@ -19,12 +19,11 @@
  * View drawing.
  */
 
-static inline void
+void
 set_view_attr(struct view *view, enum line_type type)
 {
 	if (!view->curline->selected && view->curtype != type) {
 		(void) wattrset(view->win, get_view_attr(view, type));
-		wchgat(view->win, -1, 0, get_view_color(view, type), NULL);
 		view->curtype = type;
 	}
 }
@@ -32,8 +31,8 @@ set_view_attr(struct view *view, enum line_type type)
 #define VIEW_MAX_LEN(view) ((view)->width + (view)->pos.col - (view)->col)
 
 static bool
-draw_chars(struct view *view, enum line_type type, const char *string,
-	   int max_len, bool use_tilde)
+draw_chars_attr(struct view *view, enum line_type type, const char *string,
+		int max_len, bool use_tilde)
 {
 	int len = 0;
 	int col = 0;
@@ -66,6 +65,90 @@ draw_chars(struct view *view, enum line_type type, const char *string,
 	return VIEW_MAX_LEN(view) <= 0;
 }
 
+/*
+ * Search result highlighting. Only text of lines recorded as matching
+ * the search is matched again and the matches of regular expression
+ * searches are cached by the hash of the drawn text.
+ */
+
+#define SEARCH_HIGHLIGHT_CACHE	256
+
+static struct search_highlight {
+	unsigned long hash;
+	size_t length;
+	regmatch_t match;
+	bool matched;
+	bool valid;
+} search_highlights[SEARCH_HIGHLIGHT_CACHE];
+
+static struct view *search_highlight_view;
+static char search_highlight_grep[SIZEOF_STR];
+static bool search_highlight_icase;
+
+static bool
+get_search_highlight(struct view *view, const char *string, regmatch_t *match, int flags)
+{
+	struct search_highlight *entry;
+	unsigned long hash = flags;
+	const char *pos;
+
+	if (view->grep_literal)
+		return grep_match(view, string, match, flags);
+
+	if (search_highlight_view != view ||
+	    search_highlight_icase != view->grep_icase ||
+	    strcmp(search_highlight_grep, view->grep)) {
+		memset(search_highlights, 0, sizeof(search_highlights));
+		search_highlight_view = view;
+		search_highlight_icase = view->grep_icase;
+		string_copy(search_highlight_grep, view->grep);
+	}
+
+	for (pos = string; *pos; pos++)
+		hash = hash * 33 + (unsigned char) *pos;
+
+	entry = &search_highlights[hash % SEARCH_HIGHLIGHT_CACHE];
+	if (!entry->valid || entry->hash != hash || entry->length != pos - string) {
+		entry->valid = TRUE;
+		entry->hash = hash;
+		entry->length = pos - string;
+		entry->matched = grep_match(view, string, &entry->match, flags);
+	}
+
+	*match = entry->match;
+	return entry->matched;
+}
+
+static bool
+draw_chars(struct view *view, enum line_type type, const char *string,
+	   int max_len, bool use_tilde)
+{
+	bool highlight = type != LINE_LINE_NUMBER && !view->curline->selected &&
+			 search_line_matches(view, view->curline);
+	regmatch_t match;
+	int flags = 0;
+
+	while (highlight && get_search_highlight(view, string, &match, flags) &&
+	       match.rm_so < match.rm_eo && match.rm_eo < SIZEOF_STR) {
+		char text[SIZEOF_STR];
+		unsigned long col = view->col;
+
+		string_ncopy(text, string, match.rm_so);
+		if (draw_chars_attr(view, type, text, max_len, FALSE))
+			return TRUE;
+
+		string_ncopy(text, string + match.rm_so, match.rm_eo - match.rm_so);
+		if (draw_chars_attr(view, LINE_SEARCH_RESULT, text, max_len - (view->col - col), FALSE))
+			return TRUE;
+
+		max_len -= view->col - col;
+		string += match.rm_eo;
+		flags = REG_NOTBOL;
+	}
+
+	return draw_chars_attr(view, type, string, max_len, use_tilde);
+}
+
 static bool
 draw_space(struct view *view, enum line_type type, int max, int spaces)
 {
@@ -84,11 +167,112 @@ draw_space(struct view *view, enum line_type type, int max, int spaces)
 	return VIEW_MAX_LEN(view) <= 0;
 }
 
+/*
+ * Width index of long lines. Text longer than the buffer used for
+ * expanding tabs is drawn in chunks. The offset and width of each chunk
+ * is recorded the first time a horizontally scrolled line is drawn so
+ * the chunks left of the view can be skipped without expanding and
+ * measuring them again.
+ */
+
+#define LINE_WIDTHS_CACHE	64
+
+struct line_width_chunk {
+	size_t offset;		/* Offset of the chunk in the text. */
+	size_t width;		/* Columns used for drawing the chunk. */
+};
+
+static struct line_widths {
+	struct view *view;
+	unsigned long lineno;
+	const char *text;
+	int tab_size;
+	size_t chunks;
+	struct line_width_chunk *chunk;
+} line_widths[LINE_WIDTHS_CACHE];
+
+DEFINE_ALLOCATOR(realloc_line_width_chunks, struct line_width_chunk, 64)
+
+void
+reset_line_widths(struct view *view)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(line_widths); i++)
+		if (line_widths[i].view == view)
+			line_widths[i].view = NULL;
+}
+
+static size_t
+get_chars_width(const char *string)
+{
+	int width = 0;
+	int trimmed;
+
+	if (opt_iconv_out != ICONV_NONE) {
+		string = encoding_iconv(opt_iconv_out, string);
+		if (!string)
+			return 0;
+	}
+
+	utf8_length(&string, 0, &width, INT_MAX, &trimmed, FALSE, opt_tab_size);
+	return width;
+}
+
+static struct line_widths *
+get_line_widths(struct view *view, const char *string)
+{
+	unsigned long lineno = view->curline - view->line;
+	struct line_widths *widths = &line_widths[lineno % ARRAY_SIZE(line_widths)];
+	char text[SIZEOF_STR];
+	size_t offset = 0;
+
+	if (widths->view == view && widths->lineno == lineno &&
+	    widths->text == string && widths->tab_size == opt_tab_size)
+		return widths;
+
+	widths->view = NULL;
+	widths->chunks = 0;
+
+	do {
+		size_t pos = string_expand(text, sizeof(text), string + offset, opt_tab_size);
+
+		if (!realloc_line_width_chunks(&widths->chunk, widths->chunks, 1))
+			return NULL;
+		widths->chunk[widths->chunks].offset = offset;
+		widths->chunk[widths->chunks++].width = get_chars_width(text);
+		offset += pos;
+	} while (string[offset]);
+
+	widths->view = view;
+	widths->lineno = lineno;
+	widths->text = string;
+	widths->tab_size = opt_tab_size;
+	return widths;
+}
+
 static bool
 draw_text_expanded(struct view *view, enum line_type type, const char *string, int max_len, bool use_tilde)
 {
 	static char text[SIZEOF_STR];
 
+	/* Skip the chunks of long lines left of the view. */
+	if (view->pos.col > view->col && !memchr(string, 0, sizeof(text))) {
+		struct line_widths *widths = get_line_widths(view, string);
+		size_t i;
+
+		for (i = 0; widths && i + 1 < widths->chunks; i++) {
+			size_t width = widths->chunk[i].width;
+
+			if (width > max_len || view->col + width > view->pos.col)
+				break;
+			view->col += width;
+		}
+
+		if (widths)
+			string += widths->chunk[i].offset;
+	}
+
 	do {
 		size_t pos = string_expand(text, sizeof(text), string, opt_tab_size);
 
@@ -321,11 +505,99 @@ draw_refs(struct view *view, struct ref_list *refs)
 	return FALSE;
 }
 
+/*
+ * Rendered rows. The cells of the rows drawn for a loaded view are
+ * copied from the window so the rows can be put back without calling
+ * the draw operation of the view, e.g. when switching between views.
+ * The rows of a view are reset together with its search results when
+ * its lines or the options change. Lines drawn as selected, i.e. the
+ * cursor line and lines in a selected range, are never recorded.
+ */
+
+#if defined HAVE_NCURSESW_CURSES_H || defined HAVE_NCURSESW_H
+typedef cchar_t view_cell;
+#define get_view_cells(win, y, cells, n)	mvwin_wchnstr(win, y, 0, cells, n)
+#define put_view_cells(win, y, cells, n)	mvwadd_wchnstr(win, y, 0, cells, n)
+#else
+typedef chtype view_cell;
+#define get_view_cells(win, y, cells, n)	mvwinchnstr(win, y, 0, cells, n)
+#define put_view_cells(win, y, cells, n)	mvwaddchnstr(win, y, 0, cells, n)
+#endif
+
+#define VIEW_ROWS_CACHE	512
+
+static struct view_row {
+	struct view *view;
+	unsigned long lineno;	/* Index of the line in the view. */
+	unsigned long col;	/* Horizontal scroll position. */
+	int width;
+	size_t digits;
+	unsigned long refs;	/* Generation of the refs drawn. */
+	enum line_type curtype;	/* Attribute used last. */
+	size_t cellsize;
+	view_cell *cells;
+} view_rows[VIEW_ROWS_CACHE];
+
+void
+reset_view_rows(struct view *view)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(view_rows); i++)
+		if (view_rows[i].view == view)
+			view_rows[i].view = NULL;
+}
+
+/* Rows are only recorded once a view has been loaded and never while
+ * relative dates, which go stale, are shown. */
+static struct view_row *
+get_view_row(struct view *view, unsigned long lineno, bool *valid)
+{
+	struct view_row *row;
+
+	if (view->pipe || opt_show_date == DATE_RELATIVE)
+		return NULL;
+
+	row = &view_rows[((unsigned long) view / sizeof(*view) * 127 + lineno) % VIEW_ROWS_CACHE];
+	*valid = row->view == view && row->lineno == lineno &&
+		 row->col == view->pos.col && row->width == view->width &&
+		 row->digits == view->digits && row->refs == refs_generation();
+	return row;
+}
+
+static void
+record_view_row(struct view *view, struct view_row *row, unsigned int lineno)
+{
+	row->view = NULL;
+	if (row->cellsize < view->width + 1) {
+		view_cell *cells = realloc(row->cells, (view->width + 1) * sizeof(*cells));
+
+		if (!cells)
+			return;
+		row->cells = cells;
+		row->cellsize = view->width + 1;
+	}
+
+	if (get_view_cells(view->win, lineno, row->cells, view->width) == ERR)
+		return;
+
+	row->view = view;
+	row->lineno = view->pos.offset + lineno;
+	row->col = view->pos.col;
+	row->width = view->width;
+	row->digits = view->digits;
+	row->refs = refs_generation();
+	row->curtype = view->curtype;
+}
+
 bool
 draw_view_line(struct view *view, unsigned int lineno)
 {
 	struct line *line;
+	struct view_row *row = NULL;
 	bool selected = (view->pos.offset + lineno == view->pos.lineno);
+	bool valid = FALSE;
+	bool done;
 
 	/* FIXME: Disabled during code split.
 	assert(view_is_displayed(view));
@@ -335,6 +607,19 @@ draw_view_line(struct view *view, unsigned int lineno)
 		return FALSE;
 
 	line = &view->line[view->pos.offset + lineno];
+	if (!selected)
+		row = get_view_row(view, view->pos.offset + lineno, &valid);
+
+	if (valid && !line->dirty) {
+		/* The attributes of the window are added to the cells. */
+		(void) wattrset(view->win, A_NORMAL);
+		put_view_cells(view->win, lineno, row->cells, view->width);
+		view->curline = line;
+		view->curtype = row->curtype;
+		line->selected = FALSE;
+		line->cleareol = 0;
+		return TRUE;
+	}
 
 	wmove(view->win, lineno, 0);
 	if (line->cleareol)
@@ -351,7 +636,18 @@ draw_view_line(struct view *view, unsigned int lineno)
 		view->ops->select(view, line);
 	}
 
-	return view->ops->draw(view, line, lineno);
+	done = view->ops->draw(view, line, lineno);
+
+	/* Color the rest of the row once using the last attribute instead
+	 * of on every attribute change. Skip rows drawn to the last column,
+	 * where the cursor has moved on to the next row. */
+	if (view->curtype != LINE_NONE && getcury(view->win) == lineno)
+		wchgat(view->win, -1, 0, get_view_color(view, view->curtype), NULL);
+
+	if (row && done && !line->selected)
+		record_view_row(view, row, lineno);
+
+	return done;
 }
 
 void
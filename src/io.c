@@ -80,14 +80,65 @@ encoding_convert(struct encoding *encoding, char *line)
 	return encoding_convert_string(encoding->cd, line);
 }
 
+/* Converted strings are cached by their content, since the same text is
+ * converted each time it is drawn. ASCII text is returned as is. */
+#define ENCODING_CACHE_SIZE	512
+
+static struct encoding_cache {
+	iconv_t cd;
+	unsigned long hash;
+	char *string;
+	char *converted;	/* NULL if the string was left as is. */
+} encoding_cache[ENCODING_CACHE_SIZE];
+
 const char *
 encoding_iconv(iconv_t iconv_cd, const char *string)
 {
-	char *instr = strdup(string);
-	const char *ret = encoding_convert_string(iconv_cd, instr);
+	struct encoding_cache *entry;
+	unsigned long hash = 0;
+	bool ascii = TRUE;
+	const char *pos;
+	const char *ret;
+	char *instr;
+
+	for (pos = string; *pos; pos++) {
+		hash = hash * 33 + (unsigned char) *pos;
+		if ((unsigned char) *pos >= 0x80)
+			ascii = FALSE;
+	}
+
+	if (ascii)
+		return string;
+
+	entry = &encoding_cache[hash % ENCODING_CACHE_SIZE];
+	if (entry->string && entry->cd == iconv_cd && entry->hash == hash &&
+	    !strcmp(entry->string, string))
+		return entry->converted ? entry->converted : string;
+
+	instr = strdup(string);
+	if (!instr)
+		return string;
 
-	free(instr);
-	return ret == instr ? string : ret;
+	ret = encoding_convert_string(iconv_cd, instr);
+
+	free(entry->string);
+	free(entry->converted);
+	entry->cd = iconv_cd;
+	entry->hash = hash;
+	entry->string = instr;
+	entry->converted = NULL;
+
+	if (ret == instr)
+		return string;
+
+	entry->converted = strdup(ret);
+	if (!entry->converted) {
+		free(entry->string);
+		entry->string = NULL;
+		return ret;
+	}
+
+	return entry->converted;
 }
 
 struct encoding *
@@ -184,6 +235,29 @@ io_done(struct io *io)
 	return TRUE;
 }
 
+/* Check whether the process is still running without blocking. Once it
+ * has exited its exit code is available in the status member. */
+bool
+io_is_running(struct io *io)
+{
+	pid_t waiting;
+	int status;
+
+	if (io->pid <= 0)
+		return FALSE;
+
+	waiting = waitpid(io->pid, &status, WNOHANG);
+	if (waiting == 0 || (waiting < 0 && errno == EINTR))
+		return TRUE;
+
+	if (waiting < 0)
+		io->error = errno;
+	else
+		io->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	io->pid = 0;
+	return FALSE;
+}
+
 static int
 open_trace(int devnull, const char *argv[])
 {
@@ -368,6 +442,10 @@ io_can_read(struct io *io, bool can_block)
 	struct timeval tv = { 0, 500 };
 	fd_set fds;
 
+	/* Buffers set up by io_from_string() never block. */
+	if (io->pipe == -1)
+		return TRUE;
+
 	FD_ZERO(&fds);
 	FD_SET(io->pipe, &fds);
 
@@ -399,22 +477,27 @@ io_get(struct io *io, int c, bool can_read)
 	ssize_t readsize;
 
 	while (TRUE) {
-		if (io->bufsize > 0) {
-			eol = memchr(io->bufpos, c, io->bufsize);
+		/* Only search the part of the buffer which has not already
+		 * been searched so very long lines are read in linear time. */
+		if (io->bufsize > io->bufscan) {
+			eol = memchr(io->bufpos + io->bufscan, c, io->bufsize - io->bufscan);
 			if (eol) {
 				char *line = io->bufpos;
 
 				*eol = 0;
 				io->bufpos = eol + 1;
 				io->bufsize -= io->bufpos - line;
+				io->bufscan = 0;
 				return line;
 			}
+			io->bufscan = io->bufsize;
 		}
 
 		if (io_eof(io)) {
 			if (io->bufsize) {
 				io->bufpos[io->bufsize] = 0;
 				io->bufsize = 0;
+				io->bufscan = 0;
 				return io->bufpos;
 			}
 			return NULL;
@@ -426,10 +509,14 @@ io_get(struct io *io, int c, bool can_read)
 		if (io->bufsize > 0 && io->bufpos > io->buf)
 			memmove(io->buf, io->bufpos, io->bufsize);
 
+		/* Grow the buffer geometrically to avoid copying it for
+		 * every block read while collecting a long line. */
 		if (io->bufalloc == io->bufsize) {
-			if (!io_realloc_buf(&io->buf, io->bufalloc, BUFSIZ))
+			size_t increase = MAX(io->bufalloc, BUFSIZ);
+
+			if (!io_realloc_buf(&io->buf, io->bufalloc, increase))
 				return NULL;
-			io->bufalloc += BUFSIZ;
+			io->bufalloc += increase;
 		}
 
 		io->bufpos = io->buf;
@@ -503,10 +590,11 @@ io_from_string(struct io *io, const char *str)
 
 	io_init(io);
 
-	if (!io_realloc_buf(&io->buf, io->bufalloc, len))
+	if (!io_realloc_buf(&io->buf, io->bufalloc, len + 1))
 		return FALSE;
 
-	io->bufsize = io->bufalloc = len;
+	io->bufsize = len;
+	io->bufalloc = len + 1;
 	io->bufpos = io->buf;
 	io->eof = TRUE;
 	strncpy(io->buf, str, len);
@@ -21,6 +21,14 @@
 struct keybinding {
 	int alias;
 	enum request request;
+	size_t next;		/* Next keybinding for the same request plus one. */
+};
+
+/* Lookup tables compiled from the keybindings of a keymap. */
+struct keymap_index {
+	enum request key_request[KEY_MAX + 1];	/* Request bound to key or zero. */
+	size_t *request_key;	/* First keybinding of request plus one. */
+	size_t requests;
 };
 
 static struct keymap generic_keymap = { "generic" };
@@ -61,6 +69,8 @@ add_keybinding(struct keymap *table, enum request request, int key)
 {
 	size_t i;
 
+	table->index_valid = FALSE;
+
 	for (i = 0; i < table->size; i++) {
 		if (table->data[i].alias == key) {
 			table->data[i].request = request;
@@ -75,22 +85,86 @@ add_keybinding(struct keymap *table, enum request request, int key)
 	table->data[table->size++].request = request;
 }
 
-/* Looks for a key binding first in the given map, then in the generic map, and
- * lastly in the default keybindings. */
-enum request
-get_keybinding(struct keymap *keymap, int key)
+#define is_indexed_key(key)	(0 <= (key) && (key) <= KEY_MAX)
+#define request_index(request)	((size_t) ((request) - REQ_UNKNOWN))
+
+/* Compiles the keybindings into tables mapping keys to requests and
+ * requests to their first keybinding. The tables are rebuilt lazily
+ * after the keymap has been changed. */
+static struct keymap_index *
+get_keymap_index(struct keymap *keymap)
+{
+	struct keymap_index *index = keymap->index;
+	size_t requests = 0;
+	size_t i;
+
+	if (index && keymap->index_valid)
+		return index;
+
+	if (!index) {
+		index = calloc(1, sizeof(*index));
+		if (!index)
+			die("Failed to allocate keymap index");
+		keymap->index = index;
+	} else {
+		memset(index->key_request, 0, sizeof(index->key_request));
+	}
+
+	for (i = 0; i < keymap->size; i++)
+		requests = MAX(requests, request_index(keymap->data[i].request) + 1);
+
+	if (requests > index->requests) {
+		size_t *request_key = realloc(index->request_key, requests * sizeof(*request_key));
+
+		if (!request_key)
+			die("Failed to allocate keymap index");
+		index->request_key = request_key;
+		index->requests = requests;
+	}
+	memset(index->request_key, 0, index->requests * sizeof(*index->request_key));
+
+	/* Chain keybindings backwards so each request lists its keys in
+	 * the order they were bound. */
+	for (i = keymap->size; i > 0; i--) {
+		struct keybinding *keybinding = &keymap->data[i - 1];
+		size_t request = request_index(keybinding->request);
+
+		if (is_indexed_key(keybinding->alias))
+			index->key_request[keybinding->alias] = keybinding->request;
+		keybinding->next = index->request_key[request];
+		index->request_key[request] = i;
+	}
+
+	keymap->index_valid = TRUE;
+	return index;
+}
+
+static enum request
+find_keybinding(struct keymap *keymap, int key)
 {
 	size_t i;
 
+	if (is_indexed_key(key))
+		return get_keymap_index(keymap)->key_request[key];
+
 	for (i = 0; i < keymap->size; i++)
 		if (keymap->data[i].alias == key)
 			return keymap->data[i].request;
 
-	for (i = 0; i < generic_keymap.size; i++)
-		if (generic_keymap.data[i].alias == key)
-			return generic_keymap.data[i].request;
+	return 0;
+}
+
+/* Looks for a key binding first in the given map, then in the generic map, and
+ * lastly in the default keybindings. */
+enum request
+get_keybinding(struct keymap *keymap, int key)
+{
+	enum request request = find_keybinding(keymap, key);
+
+	if (!request)
+		request = find_keybinding(&generic_keymap, key);
 
-	return (enum request) key;
+	return request ? request : (enum request) key;
 }
 
 
@@ -153,13 +227,21 @@ get_key_value(const char *name)
 const char *
 get_key_name(int key_value)
 {
+	static const char *key_names[KEY_MAX + 1];
+	static bool key_names_loaded;
 	static char key_char[] = "'X'\0";
 	const char *seq = NULL;
 	int key;
 
-	for (key = 0; key < ARRAY_SIZE(key_table); key++)
-		if (key_table[key].value == key_value)
-			seq = key_table[key].name;
+	/* Later entries are preferred as the name of a key. */
+	if (!key_names_loaded) {
+		for (key = 0; key < ARRAY_SIZE(key_table); key++)
+			key_names[key_table[key].value] = key_table[key].name;
+		key_names_loaded = TRUE;
+	}
+
+	if (is_indexed_key(key_value))
+		seq = key_names[key_value];
 
 	if (seq == NULL && key_value < 0x7f) {
 		char *s = key_char + 1;
@@ -191,15 +273,15 @@ static bool
 append_keymap_request_keys(char *buf, size_t *pos, enum request request,
 			   struct keymap *keymap, bool all)
 {
-	int i;
-
-	for (i = 0; i < keymap->size; i++) {
-		if (keymap->data[i].request == request) {
-			if (!append_key(buf, pos, &keymap->data[i]))
-				return FALSE;
-			if (!all)
-				break;
-		}
+	struct keymap_index *index = get_keymap_index(keymap);
+	size_t i = request_index(request) < index->requests
+		 ? index->request_key[request_index(request)] : 0;
+
+	for (; i; i = keymap->data[i - 1].next) {
+		if (!append_key(buf, pos, &keymap->data[i - 1]))
+			return FALSE;
+		if (!all)
+			break;
 	}
 
 	return TRUE;
@@ -23,22 +23,70 @@ static size_t line_rules;
 static struct line_info **color_pair;
 static size_t color_pairs;
 
+/* Rules are chained by the case folded first character of the line
+ * they match in the order they were added, so classifying a line only
+ * has to look at the few rules that can match it. Rule numbers are
+ * stored plus one so zero can end a chain. */
+static size_t line_rule_first[256];
+static size_t line_rule_last[256];
+static size_t *line_rule_next;
+static size_t line_rules_indexed;
+
 DEFINE_ALLOCATOR(realloc_line_rule, struct line_rule, 8)
+DEFINE_ALLOCATOR(realloc_line_rule_next, size_t, 8)
 DEFINE_ALLOCATOR(realloc_color_pair, struct line_info *, 8)
 
+static bool
+index_line_rules(void)
+{
+	if (!realloc_line_rule_next(&line_rule_next, line_rules_indexed,
+				    line_rules - line_rules_indexed))
+		return FALSE;
+
+	for (; line_rules_indexed < line_rules; line_rules_indexed++) {
+		struct line_rule *rule = &line_rule[line_rules_indexed];
+		unsigned char first = tolower((unsigned char) *rule->line);
+
+		line_rule_next[line_rules_indexed] = 0;
+		if (!rule->linelen)
+			continue;
+
+		if (line_rule_last[first])
+			line_rule_next[line_rule_last[first] - 1] = line_rules_indexed + 1;
+		else
+			line_rule_first[first] = line_rules_indexed + 1;
+		line_rule_last[first] = line_rules_indexed + 1;
+	}
+
+	return TRUE;
+}
+
 enum line_type
 get_line_type(const char *line)
 {
-	int linelen = strlen(line);
-	enum line_type type;
+	size_t rule_no;
 
-	for (type = 0; type < line_rules; type++) {
-		struct line_rule *rule = &line_rule[type];
+	if (line_rules_indexed < line_rules && !index_line_rules()) {
+		enum line_type type;
+
+		for (type = 0; type < line_rules; type++) {
+			struct line_rule *rule = &line_rule[type];
+
+			if (rule->linelen && !strncasecmp(rule->line, line, rule->linelen))
+				return type;
+		}
+
+		return LINE_DEFAULT;
+	}
+
+	for (rule_no = line_rule_first[tolower((unsigned char) *line)];
+	     rule_no; rule_no = line_rule_next[rule_no - 1]) {
+		struct line_rule *rule = &line_rule[rule_no - 1];
 
-		/* Case insensitive search matches Signed-off-by lines better. */
-		if (rule->linelen && linelen >= rule->linelen &&
-		    !strncasecmp(rule->line, line, rule->linelen))
-			return type;
+		/* Case insensitive search matches Signed-off-by lines
+		 * better. Lines shorter than the rule end the comparison. */
+		if (!strncasecmp(rule->line, line, rule->linelen))
+			return rule_no - 1;
 	}
 
 	return LINE_DEFAULT;
@@ -21,6 +21,7 @@
 #include "tig/git.h"
 #include "tig/status.h"
 #include "tig/main.h"
+#include "tig/watch.h"
 
 /*
  * Revision graph
@@ -140,17 +141,6 @@ main_flush_commit(struct view *view, struct commit *commit)
 		main_add_commit(view, LINE_MAIN_COMMIT, commit, "", FALSE);
 }
 
-static bool
-main_has_changes(const char *argv[])
-{
-	struct io io;
-
-	if (!io_run(&io, IO_BG, NULL, opt_env, argv, -1))
-		return FALSE;
-	io_done(&io);
-	return io.status == 1;
-}
-
 static void
 main_add_changes_commit(struct view *view, enum line_type type, const char *parent, const char *title)
 {
@@ -176,27 +166,39 @@ main_add_changes_commit(struct view *view, enum line_type type, const char *pare
 		graph_render_parents(&state->graph);
 }
 
+enum main_changes_step {
+	MAIN_CHANGES_DONE,
+	MAIN_CHANGES_UPDATE_INDEX,
+	MAIN_CHANGES_UNSTAGED,
+	MAIN_CHANGES_STAGED,
+};
+
+/* Changes found the last time the working tree was checked and the
+ * state of the background check that is currently running. */
+static struct {
+	unsigned long generation;
+	char head[SIZEOF_REV];
+	bool staged;
+	bool unstaged;
+	bool reuse;			/* Use the result for the next load. */
+	struct view *view;		/* View waiting for the result. */
+	unsigned long lineno;		/* Where to insert the result. */
+	enum main_changes_step step;
+	struct io io;
+} main_changes;
+
 static void
-main_add_changes_commits(struct view *view, struct main_state *state, const char *parent)
+main_add_changes_result(struct view *view, const char *parent)
 {
-	const char *staged_argv[] = { GIT_DIFF_STAGED_FILES("--quiet") };
-	const char *unstaged_argv[] = { GIT_DIFF_UNSTAGED_FILES("--quiet") };
 	const char *staged_parent = NULL_ID;
 	const char *unstaged_parent = parent;
 
-	if (!is_head_commit(parent))
-		return;
-
-	state->added_changes_commits = TRUE;
-
-	io_run_bg(update_index_argv);
-
-	if (!main_has_changes(unstaged_argv)) {
+	if (!main_changes.unstaged) {
 		unstaged_parent = NULL;
 		staged_parent = parent;
 	}
 
-	if (!main_has_changes(staged_argv)) {
+	if (!main_changes.staged) {
 		staged_parent = NULL;
 	}
 
@@ -204,6 +206,187 @@ main_add_changes_commits(struct view *view, struct main_state *state, const char
 	main_add_changes_commit(view, LINE_STAT_UNSTAGED, unstaged_parent, "Unstaged changes");
 }
 
+static void
+main_stop_changes_check(void)
+{
+	if (main_changes.step != MAIN_CHANGES_DONE) {
+		io_kill(&main_changes.io);
+		io_done(&main_changes.io);
+		if (main_changes.step == MAIN_CHANGES_UPDATE_INDEX)
+			watch_index_end();
+	}
+
+	main_changes.step = MAIN_CHANGES_DONE;
+	main_changes.view = NULL;
+}
+
+static bool
+main_run_changes_check(enum main_changes_step step)
+{
+	const char *unstaged_argv[] = { GIT_DIFF_UNSTAGED_FILES("--quiet") };
+	const char *staged_argv[] = { GIT_DIFF_STAGED_FILES("--quiet") };
+	const char **argv = step == MAIN_CHANGES_UPDATE_INDEX ? update_index_argv
+			  : step == MAIN_CHANGES_UNSTAGED ? unstaged_argv
+			  : staged_argv;
+
+	main_changes.step = step;
+	if (step == MAIN_CHANGES_UPDATE_INDEX)
+		watch_index_begin();
+	if (io_run(&main_changes.io, IO_RD, NULL, opt_env, argv))
+		return TRUE;
+
+	main_stop_changes_check();
+	return FALSE;
+}
+
+/* Insert the result of the background check above the HEAD commit. */
+static void
+main_splice_changes_commits(struct view *view)
+{
+	struct main_state *state = view->private;
+	unsigned long lineno = main_changes.lineno;
+	struct commit *head = lineno < view->lines ? view->line[lineno].data : NULL;
+	char reflogmsg[sizeof(state->reflogmsg)];
+	struct graph graph = state->graph;
+	struct line added[2];
+	size_t lines = view->lines;
+	size_t count, i;
+	unsigned long number = 0;
+
+	if (!head || strcmp(head->id, main_changes.head) ||
+	    (!main_changes.staged && !main_changes.unstaged))
+		return;
+
+	/* Rendering the graph above other commits requires replaying
+	 * it, so reload the view instead. */
+	if (state->with_graph && lineno > 0) {
+		main_changes.reuse = TRUE;
+		refresh_view(view);
+		return;
+	}
+
+	/* Render the new commits in a graph of their own. */
+	string_copy(reflogmsg, state->reflogmsg);
+	memset(&state->graph, 0, sizeof(state->graph));
+	main_add_changes_result(view, main_changes.head);
+	if (state->with_graph)
+		done_graph(&state->graph);
+	state->graph = graph;
+	string_copy(state->reflogmsg, reflogmsg);
+
+	count = view->lines - lines;
+	if (!count)
+		return;
+
+	memcpy(added, view->line + lines, count * sizeof(*added));
+	memmove(view->line + lineno + count, view->line + lineno,
+		(lines - lineno) * sizeof(*view->line));
+	memcpy(view->line + lineno, added, count * sizeof(*added));
+	reset_search_results(view);
+
+	/* The new lines are custom lines which are not numbered. Number
+	 * the commits below them as if they had been added in order. */
+	for (i = 0; i < lineno; i++)
+		if (view->line[i].lineno)
+			number = view->line[i].lineno;
+
+	for (i = lineno; i < view->lines; i++) {
+		view->line[i].lineno = i < lineno + count ? 0 : ++number;
+		view->line[i].dirty = 1;
+	}
+
+	/* Keep the cursor on the same commit if it has been moved. */
+	if (view->pos.lineno > main_changes.lineno)
+		view->pos.lineno += count;
+	if (view->pos.offset > main_changes.lineno)
+		view->pos.offset += count;
+
+	if (view_is_displayed(view)) {
+		redraw_view(view);
+		update_view_title(view);
+	}
+}
+
+/* Advance the background check for working tree changes. Returns TRUE
+ * while it is running. */
+static bool
+main_poll(struct view *view)
+{
+	int status;
+
+	if (main_changes.view != view || main_changes.step == MAIN_CHANGES_DONE)
+		return FALSE;
+
+	/* The pipe is closed when the command exits, so wait briefly for
+	 * it instead of spinning on waitpid(). Any output is discarded. */
+	if (!io_eof(&main_changes.io)) {
+		char buf[BUFSIZ];
+
+		if (!io_can_read(&main_changes.io, FALSE) ||
+		    io_read(&main_changes.io, buf, sizeof(buf)) > 0)
+			return TRUE;
+	}
+
+	if (io_is_running(&main_changes.io))
+		return TRUE;
+
+	status = main_changes.io.status;
+	io_done(&main_changes.io);
+
+	switch (main_changes.step) {
+	case MAIN_CHANGES_UPDATE_INDEX:
+		watch_index_end();
+		main_changes.generation = watch_generation();
+		return main_run_changes_check(MAIN_CHANGES_UNSTAGED);
+
+	case MAIN_CHANGES_UNSTAGED:
+		main_changes.unstaged = status == 1;
+		return main_run_changes_check(MAIN_CHANGES_STAGED);
+
+	case MAIN_CHANGES_STAGED:
+	default:
+		main_changes.staged = status == 1;
+		main_changes.step = MAIN_CHANGES_DONE;
+		main_changes.view = NULL;
+		main_splice_changes_commits(view);
+		return FALSE;
+	}
+}
+
+static void
+main_add_changes_commits(struct view *view, struct main_state *state, const char *parent)
+{
+	unsigned long generation = 0;
+	bool reuse = main_changes.reuse;
+
+	if (!is_head_commit(parent))
+		return;
+
+	state->added_changes_commits = TRUE;
+	main_changes.reuse = FALSE;
+
+	if (opt_watch_worktree && watch_init())
+		generation = watch_generation();
+
+	/* Reuse the previous result when the working tree watcher has
+	 * seen no changes since. */
+	if ((reuse || (generation && generation == main_changes.generation)) &&
+	    !strncmp(main_changes.head, parent, SIZEOF_REV - 1)) {
+		main_add_changes_result(view, parent);
+		return;
+	}
+
+	/* Check for changes in the background and insert the result
+	 * once done so loading the history is not blocked. */
+	main_stop_changes_check();
+	main_changes.staged = main_changes.unstaged = FALSE;
+	string_copy_rev(main_changes.head, parent);
+	if (main_run_changes_check(MAIN_CHANGES_UPDATE_INDEX)) {
+		main_changes.view = view;
+		main_changes.lineno = view->lines;
+	}
+}
+
 static bool
 main_open(struct view *view, enum open_flags flags)
 {
@@ -245,6 +428,9 @@ main_done(struct view *view)
 	struct main_state *state = view->private;
 	int i;
 
+	if (main_changes.view == view)
+		main_stop_changes_check();
+
 	for (i = 0; i < view->lines; i++) {
 		struct commit *commit = view->line[i].data;
 
@@ -285,7 +471,7 @@ main_draw(struct view *view, struct line *line, unsigned int lineno)
 		return TRUE;
 
 	if (opt_show_id) {
-		if (state->reflogs) {
+		if (state->reflogs && line->lineno && line->lineno <= state->reflogs) {
 			const char *id = state->reflog[line->lineno - 1];
 
 			if (draw_id_custom(view, LINE_ID, id, state->reflog_width))
@@ -516,17 +702,18 @@ main_request(struct view *view, enum request request, struct line *line)
 }
 
 static bool
-grep_refs(struct line *line, struct commit *commit, regex_t *regex)
+grep_refs(struct view *view, struct line *line, struct commit *commit)
 {
 	struct ref_list *list;
-	regmatch_t pmatch;
 	size_t i;
 
 	if (!opt_show_refs || !(list = main_get_commit_refs(line, commit)))
 		return FALSE;
 
 	for (i = 0; i < list->size; i++) {
-		if (!regexec(regex, list->refs[i]->name, 1, &pmatch, 0))
+		const char *text[] = { list->refs[i]->name, NULL };
+
+		if (grep_text(view, text))
 			return TRUE;
 	}
 
@@ -545,7 +732,7 @@ main_grep(struct view *view, struct line *line)
 		NULL
 	};
 
-	return grep_text(view, text) || grep_refs(line, commit, view->regex);
+	return grep_text(view, text) || grep_refs(view, line, commit);
 }
 
 static struct ref *
@@ -602,6 +789,7 @@ struct view_ops main_ops = {
 	main_grep,
 	main_select,
 	main_done,
+	main_poll,
 };
 
 /* vim: set ts=8 sw=8 noexpandtab: */
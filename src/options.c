@@ -445,6 +445,9 @@ option_set_command(int argc, const char *argv[])
 		return code;
 	}
 
+	if (!strcmp(argv[0], "diff-lazy-threshold"))
+		return parse_int(&opt_diff_lazy_threshold, argv[2], 0, 999999999);
+
 	if (!strcmp(argv[0], "ignore-space") && !*opt_ignore_space_arg) {
 		enum status_code code = parse_enum(&opt_ignore_space, argv[2], ignore_space_map);
 
@@ -464,6 +467,12 @@ option_set_command(int argc, const char *argv[])
 	if (!strcmp(argv[0], "status-untracked-dirs"))
 		return parse_bool(&opt_status_untracked_dirs, argv[2]);
 
+	if (!strcmp(argv[0], "watch-worktree"))
+		return parse_bool(&opt_watch_worktree, argv[2]);
+
+	if (!strcmp(argv[0], "blame-cache"))
+		return parse_bool(&opt_blame_cache, argv[2]);
+
 	if (!strcmp(argv[0], "read-git-colors"))
 		return parse_bool(&opt_read_git_colors, argv[2]);
 
@@ -473,6 +482,9 @@ option_set_command(int argc, const char *argv[])
 	if (!strcmp(argv[0], "focus-child"))
 		return parse_bool(&opt_focus_child, argv[2]);
 
+	if (!strcmp(argv[0], "frame-rate"))
+		return parse_int(&opt_frame_rate, argv[2], 0, 1000);
+
 	if (!strcmp(argv[0], "wrap-lines"))
 		return parse_bool(&opt_wrap_lines, argv[2]);
 
@@ -102,8 +102,10 @@ pager_wrap_line(struct view *view, const char *data, enum line_type type)
 	size_t datalen = strlen(data);
 	size_t lineno = 0;
 
+	view->wrap_width = view->width;
+
 	while (datalen > 0 || !has_first_line) {
-		bool wrapped = !!first_line;
+		bool wrapped = has_first_line;
 		size_t linelen = string_expanded_length(data, datalen, opt_tab_size, view->width - !!wrapped);
 		struct line *line;
 		char *text;
@@ -133,6 +135,76 @@ pager_wrap_line(struct view *view, const char *data, enum line_type type)
 	return has_first_line ? &view->line[first_line] : NULL;
 }
 
+/* Wrap the lines of a pager view again after the view width has changed,
+ * so the view does not have to be reloaded. Fragments of each wrapped
+ * line are joined and the line is split at the new width. */
+bool
+pager_rewrap_view(struct view *view)
+{
+	struct line *lines = view->line;
+	size_t lines_size = view->lines;
+	unsigned long cursor = view->pos.lineno;
+	unsigned long cursor_row = view->pos.lineno - view->pos.offset;
+	size_t i, end;
+
+	if (!opt_wrap_lines || view->ops->draw != pager_draw ||
+	    !view->wrap_width || view->wrap_width == view->width)
+		return FALSE;
+
+	view->line = NULL;
+	view->lines = view->custom_lines = 0;
+	view->pos.lineno = 0;
+
+	for (i = 0; i < lines_size; i = end) {
+		struct line *line = &lines[i];
+		size_t size = line->data ? strlen(line->data) : 0;
+		char *data;
+
+		for (end = i + 1; end < lines_size && lines[end].wrapped; end++)
+			size += strlen(lines[end].data);
+
+		if (cursor >= i && cursor < end)
+			view->pos.lineno = view->lines;
+
+		if (end == i + 1 &&
+		    (!line->data || string_expanded_length(line->data, size, opt_tab_size, view->width) == size)) {
+			struct line *copy = add_line(view, NULL, line->type, 0, FALSE);
+
+			if (!copy)
+				break;
+			copy->data = line->data;
+			copy->user_flags = line->user_flags;
+			continue;
+		}
+
+		data = malloc(size + 1);
+		if (!data)
+			break;
+
+		for (size = 0; i < end; i++) {
+			strcpy(data + size, lines[i].data);
+			size += strlen(lines[i].data);
+			free(lines[i].data);
+		}
+
+		if (!pager_wrap_line(view, data, line->type)) {
+			free(data);
+			break;
+		}
+		free(data);
+	}
+
+	for (; i < lines_size; i++)
+		free(lines[i].data);
+	free(lines);
+
+	view->wrap_width = view->width;
+	view->pos.offset = view->pos.lineno > cursor_row ? view->pos.lineno - cursor_row : 0;
+	reset_search_results(view);
+	reset_line_widths(view);
+	return TRUE;
+}
+
 bool
 pager_common_read(struct view *view, const char *data, enum line_type type)
 {
@@ -14,6 +14,7 @@
 #include "tig/tig.h"
 #include "tig/util.h"
 #include "tig/parse.h"
+#include "compat/hashtab.h"
 
 size_t
 parse_size(const char *text, int *max_digits)
@@ -147,17 +148,34 @@ match_blame_header(const char *name, char **line)
 bool
 parse_blame_info(struct blame_commit *commit, char *line)
 {
+	/* Commit metadata is only parsed until it is complete. */
+	struct commit_info *info = commit->info && !commit->info->title ? commit->info : NULL;
+
 	if (match_blame_header("author ", &line)) {
-		parse_author_line(line, &commit->author, NULL);
+		if (info)
+			parse_author_line(line, &info->author, NULL);
+
+	} else if (match_blame_header("author-mail ", &line)) {
+		char *email = line + (*line == '<');
+		char *end = strchr(email, '>');
+
+		if (end)
+			*end = 0;
+		/* Match the author read by the tree view. */
+		if (info && info->author && *email)
+			info->author = get_author(info->author->name, email);
 
 	} else if (match_blame_header("author-time ", &line)) {
-		parse_timesec(&commit->time, line);
+		if (info)
+			parse_timesec(&info->time, line);
 
 	} else if (match_blame_header("author-tz ", &line)) {
-		parse_timezone(&commit->time, line);
+		if (info)
+			parse_timezone(&info->time, line);
 
 	} else if (match_blame_header("summary ", &line)) {
-		string_ncopy(commit->title, line, strlen(line));
+		if (info)
+			set_commit_info_title(info, line);
 
 	} else if (match_blame_header("previous ", &line)) {
 		if (strlen(line) <= SIZEOF_REV)
@@ -323,4 +341,144 @@ get_author(const char *name, const char *email)
 	return ident;
 }
 
+/* Commit metadata cache shared between views. Entries are hashed by
+ * their binary ID and reference counted. Unused entries are kept for
+ * reuse, but only the most recently released are kept around. */
+#define COMMIT_INFO_UNUSED_MAX	4096
+
+static htab_t commit_infos;
+static struct commit_info *commit_infos_unused;	/* Oldest unused entry. */
+static struct commit_info *commit_infos_unused_tail;
+static size_t commit_infos_unused_size;
+
+static hashval_t
+commit_info_hash(const void *entry)
+{
+	const struct commit_info *info = entry;
+	hashval_t hash;
+
+	/* The ID is a hash, so any part of it will do. */
+	memcpy(&hash, info->oid, sizeof(hash));
+	return hash;
+}
+
+static int
+commit_info_eq(const void *entry, const void *oid)
+{
+	return !memcmp(((const struct commit_info *) entry)->oid, oid, SIZEOF_OID);
+}
+
+static bool
+parse_oid(unsigned char oid[SIZEOF_OID], const char *id)
+{
+	int i;
+
+	for (i = 0; i < SIZEOF_OID * 2; i++) {
+		int c = tolower(id[i]);
+		int value = isdigit(c) ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+
+		if (value < 0)
+			return FALSE;
+		if (i % 2)
+			oid[i / 2] |= value;
+		else
+			oid[i / 2] = value << 4;
+	}
+
+	return !id[i];
+}
+
+static void
+commit_info_unlink_unused(struct commit_info *info)
+{
+	if (info->prev)
+		info->prev->next = info->next;
+	else
+		commit_infos_unused = info->next;
+	if (info->next)
+		info->next->prev = info->prev;
+	else
+		commit_infos_unused_tail = info->prev;
+	info->prev = info->next = NULL;
+	commit_infos_unused_size--;
+}
+
+/* Returns a referenced entry for the given full SHA1 ID, which must be
+ * released with put_commit_info(). */
+struct commit_info *
+get_commit_info(const char *id)
+{
+	unsigned char oid[SIZEOF_OID];
+	struct commit_info *info;
+	hashval_t hash;
+	void **slot;
+
+	if (!parse_oid(oid, id))
+		return NULL;
+
+	if (!commit_infos) {
+		commit_infos = htab_create_alloc(1024, commit_info_hash, commit_info_eq, NULL, calloc, free);
+		if (!commit_infos)
+			return NULL;
+	}
+
+	memcpy(&hash, oid, sizeof(hash));
+	info = htab_find_with_hash(commit_infos, oid, hash);
+	if (!info) {
+		info = calloc(1, sizeof(*info));
+		if (!info)
+			return NULL;
+		slot = htab_find_slot_with_hash(commit_infos, oid, hash, INSERT);
+		if (!slot) {
+			free(info);
+			return NULL;
+		}
+		memcpy(info->oid, oid, sizeof(oid));
+		string_copy_rev(info->id, id);
+		*slot = info;
+
+	} else if (!info->refs) {
+		commit_info_unlink_unused(info);
+	}
+
+	info->refs++;
+	return info;
+}
+
+void
+put_commit_info(struct commit_info *info)
+{
+	if (!info || --info->refs)
+		return;
+
+	info->prev = commit_infos_unused_tail;
+	if (commit_infos_unused_tail)
+		commit_infos_unused_tail->next = info;
+	else
+		commit_infos_unused = info;
+	commit_infos_unused_tail = info;
+	commit_infos_unused_size++;
+
+	while (commit_infos_unused_size > COMMIT_INFO_UNUSED_MAX) {
+		struct commit_info *oldest = commit_infos_unused;
+
+		commit_info_unlink_unused(oldest);
+		htab_remove_elt_with_hash(commit_infos, oldest->oid, commit_info_hash(oldest));
+		free(oldest->title);
+		free(oldest);
+	}
+}
+
+bool
+set_commit_info_title(struct commit_info *info, const char *title)
+{
+	char *copy = strdup(title);
+
+	if (!copy)
+		return FALSE;
+	free(info->title);
+	info->title = copy;
+	return TRUE;
+}
+
 /* vim: set ts=8 sw=8 noexpandtab: */
@@ -24,6 +24,8 @@ static struct ref *refs_head = NULL;
 static struct ref_list **ref_lists = NULL;
 static size_t ref_lists_size = 0;
 
+static unsigned long refs_changes = 0;
+
 DEFINE_ALLOCATOR(realloc_refs, struct ref *, 256)
 DEFINE_ALLOCATOR(realloc_refs_list, struct ref *, 8)
 DEFINE_ALLOCATOR(realloc_ref_lists, struct ref_list *, 8)
@@ -133,6 +135,8 @@ add_to_refs(const char *id, size_t idlen, char *name, size_t namelen, struct ref
 	bool head = FALSE;
 	int pos;
 
+	refs_changes++;
+
 	if (!prefixcmp(name, "refs/tags/")) {
 		if (!suffixcmp(name, namelen, "^{}")) {
 			namelen -= 3;
@@ -228,6 +232,8 @@ reload_refs(const char *git_dir, const char *remote_name, char *head, size_t hea
 	struct ref_opt opt = { remote_name, head };
 	size_t i;
 
+	refs_changes++;
+
 	if (!init) {
 		if (!argv_from_env(ls_remote_argv, "TIG_LS_REMOTE"))
 			return ERR;
@@ -276,6 +282,13 @@ load_refs(bool force)
 	return reload_refs(repo.git_dir, repo.remote, repo.head, sizeof(repo.head));
 }
 
+/* Changes every time refs are loaded or added. */
+unsigned long
+refs_generation(void)
+{
+	return refs_changes;
+}
+
 int
 add_ref(const char *id, char *name, const char *remote_name, const char *head)
 {
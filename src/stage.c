@@ -22,6 +22,7 @@
 #include "tig/pager.h"
 #include "tig/diff.h"
 #include "tig/status.h"
+#include "tig/watch.h"
 
 DEFINE_ALLOCATOR(realloc_ints, int, 32)
 
@@ -29,98 +30,656 @@ struct stage_state {
 	struct diff_state diff;
 	size_t chunks;
 	int *chunk;
+	bool selecting;			/* Whether a range is being selected. */
+	unsigned long select_lineno;	/* Line where the selection started. */
+	unsigned long cursor_lineno;	/* Line of the last selected cursor. */
+};
+
+DEFINE_ALLOCATOR(realloc_patch, char, 4096)
+
+/* Patch assembled in memory from the chunks of the diff so that any
+ * number of changes across chunks and files can be applied with a
+ * single git-apply(1) run. */
+struct stage_patch {
+	char *buf;
+	size_t size;
+	struct line *diff_hdr;		/* Header of the file being written. */
+	bool reverse;			/* Whether the patch is applied in reverse. */
 };
 
 static bool
-stage_diff_write(struct io *io, struct line *line, struct line *end)
+stage_patch_write(struct stage_patch *patch, char marker, const char *data)
 {
-	while (line < end) {
-		if (!io_write(io, line->data, strlen(line->data)) ||
-		    !io_write(io, "\n", 1))
-			return FALSE;
-		line++;
-		if (line->type == LINE_DIFF_CHUNK ||
-		    line->type == LINE_DIFF_HEADER)
+	size_t datalen = strlen(data);
+
+	if (!realloc_patch(&patch->buf, patch->size, datalen + 2))
+		return FALSE;
+
+	if (marker)
+		patch->buf[patch->size++] = marker;
+	memcpy(patch->buf + patch->size, data, datalen);
+	patch->size += datalen;
+	patch->buf[patch->size++] = '\n';
+	return TRUE;
+}
+
+static struct line *
+stage_chunk_end(struct view *view, struct line *chunk)
+{
+	struct line *end;
+
+	for (end = chunk + 1; view_has_line(view, end); end++)
+		if (end->type == LINE_DIFF_CHUNK || end->type == LINE_DIFF_HEADER)
 			break;
+
+	return end;
+}
+
+/* A chunk position refers to the line before the chunk when it spans
+ * no lines and to the first line otherwise. */
+static unsigned long
+stage_chunk_position(unsigned long position, unsigned long lines, unsigned long new_lines)
+{
+	if (!lines && new_lines)
+		return position + 1;
+	if (lines && !new_lines && position)
+		return position - 1;
+	return position;
+}
+
+/* Changes outside the range are either kept as context or dropped so
+ * that they remain in the target when the patch is applied. */
+static char
+stage_patch_marker(struct stage_patch *patch, struct line *line,
+		   struct line *from, struct line *to)
+{
+	char marker = *(const char *) line->data;
+
+	if ((from <= line && line <= to) || (marker != '+' && marker != '-'))
+		return marker;
+
+	return marker == (patch->reverse ? '+' : '-') ? ' ' : 0;
+}
+
+/* Add the changes of a chunk found between from and to. */
+static bool
+stage_patch_add_chunk(struct stage_patch *patch, struct view *view,
+		      struct line *chunk, struct line *from, struct line *to)
+{
+	struct line *diff_hdr = diff_find_prev_line_by_type(view, chunk, LINE_DIFF_HEADER);
+	struct line *end = stage_chunk_end(view, chunk);
+	struct chunk_header header;
+	unsigned long old_lines = 0, new_lines = 0;
+	bool partial = FALSE, changes = FALSE;
+	bool eof_context = FALSE, eof_change = FALSE;
+	char buf[SIZEOF_STR];
+	struct line *pos;
+
+	if (!diff_hdr)
+		return FALSE;
+
+	for (pos = chunk + 1; pos < end; pos++) {
+		char marker = stage_patch_marker(patch, pos, from, to);
+		bool eof = pos + 1 < end && *(const char *) pos[1].data == '\\';
+
+		if (marker == ' ' || marker == '-')
+			old_lines++;
+		if (marker == ' ' || marker == '+')
+			new_lines++;
+		if (marker != *(const char *) pos->data) {
+			partial = TRUE;
+			eof_context |= marker && eof;
+		} else if (marker == '+' || marker == '-') {
+			changes = TRUE;
+			eof_change |= eof;
+		}
+	}
+
+	if (!changes)
+		return TRUE;
+
+	/* A line missing its newline cannot be kept as context when a
+	 * change to the end of the file is applied. */
+	if (eof_context && eof_change)
+		return FALSE;
+
+	if (patch->diff_hdr != diff_hdr) {
+		for (pos = diff_hdr; pos < view->line + view->lines; pos++) {
+			if (pos > diff_hdr &&
+			    (pos->type == LINE_DIFF_CHUNK || pos->type == LINE_DIFF_HEADER))
+				break;
+			if (!stage_patch_write(patch, 0, pos->data))
+				return FALSE;
+		}
+		patch->diff_hdr = diff_hdr;
+	}
+
+	if (!partial) {
+		for (pos = chunk; pos < end; pos++)
+			if (!stage_patch_write(patch, 0, pos->data))
+				return FALSE;
+		return TRUE;
+	}
+
+	/* Combined diffs of unmerged files cannot be applied partially. */
+	if (prefixcmp(chunk->data, "@@ -") ||
+	    !parse_chunk_header(&header, chunk->data) ||
+	    !string_format(buf, "@@ -%lu,%lu +%lu,%lu @@",
+			   stage_chunk_position(header.old.position, header.old.lines, old_lines),
+			   old_lines,
+			   stage_chunk_position(header.new.position, header.new.lines, new_lines),
+			   new_lines) ||
+	    !stage_patch_write(patch, 0, buf))
+		return FALSE;
+
+	for (pos = chunk + 1; pos < end; pos++) {
+		const char *data = pos->data;
+		char marker = stage_patch_marker(patch, pos, from, to);
+
+		/* Keep "\ No newline at end of file" with its line. */
+		if (marker == '\\' && pos[-1].type != LINE_DIFF_CHUNK &&
+		    !stage_patch_marker(patch, &pos[-1], from, to))
+			continue;
+
+		if (marker && !stage_patch_write(patch, marker, data + 1))
+			return FALSE;
 	}
 
 	return TRUE;
 }
 
 static bool
-stage_apply_chunk(struct view *view, struct line *chunk, struct line *line, bool revert)
+stage_patch_apply(struct stage_patch *patch, bool revert)
 {
 	const char *apply_argv[SIZEOF_ARG] = {
 		"git", "apply", "--whitespace=nowarn", NULL
 	};
-	struct line *diff_hdr;
 	struct io io;
 	int argc = 3;
-
-	diff_hdr = find_prev_line_by_type(view, chunk, LINE_DIFF_HEADER);
-	if (!diff_hdr)
-		return FALSE;
+	bool ok;
 
 	if (!revert)
 		apply_argv[argc++] = "--cached";
-	if (line != NULL)
-		apply_argv[argc++] = "--unidiff-zero";
-	if (revert || stage_line_type == LINE_STAT_STAGED)
+	if (patch->reverse)
 		apply_argv[argc++] = "-R";
 	apply_argv[argc++] = "-";
 	apply_argv[argc++] = NULL;
-	if (!io_run(&io, IO_WR, repo.cdup, opt_env, apply_argv))
-		return FALSE;
 
-	if (line != NULL) {
-		unsigned long lineno = 0;
-		struct line *context = chunk + 1;
-		const char *markers[] = {
-			line->type == LINE_DIFF_DEL ? ""   : ",0",
-			line->type == LINE_DIFF_DEL ? ",0" : "",
-		};
+	watch_index_begin();
+	ok = io_run(&io, IO_WR, repo.cdup, opt_env, apply_argv) &&
+	     io_write(&io, patch->buf, patch->size);
+	ok = io_done(&io) && ok;
+
+	/* Without a file the diff may span all changed files. */
+	if (stage_status.status) {
+		watch_mark_path(stage_status.old.name);
+		watch_mark_path(stage_status.new.name);
+	} else {
+		watch_mark_path(NULL);
+	}
+	watch_index_end();
+
+	return ok;
+}
+
+static struct line *
+stage_first_chunk(struct view *view, struct line *from)
+{
+	struct line *chunk = diff_find_prev_line_by_type(view, from, LINE_DIFF_CHUNK);
+
+	if (!chunk || stage_chunk_end(view, chunk) <= from)
+		chunk = diff_find_next_line_by_type(view, from, LINE_DIFF_CHUNK);
+	return chunk;
+}
+
+/* Apply all changes between from and to using a single patch. */
+static bool
+stage_apply_lines(struct view *view, struct line *from, struct line *to, bool revert)
+{
+	struct stage_patch patch = { NULL, 0, NULL, revert || stage_line_type == LINE_STAT_STAGED };
+	struct line *chunk = stage_first_chunk(view, from);
+	bool ok = TRUE;
+
+	for (; ok && chunk && chunk <= to;
+	     chunk = diff_find_next_line_by_type(view, chunk + 1, LINE_DIFF_CHUNK))
+		ok = stage_patch_add_chunk(&patch, view, chunk, from, to);
+
+	ok = ok && patch.size && stage_patch_apply(&patch, revert);
+	free(patch.buf);
+	return ok;
+}
+
+static void
+stage_delete_lines(struct view *view, struct line *line, size_t lines,
+		   unsigned long *to_lineno)
+{
+	while (lines-- > 0) {
+		if (line - view->line <= *to_lineno)
+			(*to_lineno)--;
+		delete_line(view, line);
+	}
+}
+
+static long
+stage_context_lines(struct line *line, struct line *end, int direction)
+{
+	long lines = 0;
+
+	for (; line != end && *(const char *) line->data == ' '; line += direction)
+		lines++;
+
+	return lines;
+}
+
+/* Delete the lines of an emptied chunk and of its file header if it was
+ * the last chunk of the file. Returns the line after the deleted ones. */
+static struct line *
+stage_delete_chunk(struct view *view, struct line *chunk, struct line *end,
+		   unsigned long *to_lineno)
+{
+	struct line *diff_hdr = diff_find_prev_line_by_type(view, chunk, LINE_DIFF_HEADER);
+	struct line *prev_chunk = diff_find_prev_line_by_type(view, chunk - 1, LINE_DIFF_CHUNK);
+	bool last = (!view_has_line(view, end) || end->type == LINE_DIFF_HEADER) &&
+		    (!prev_chunk || prev_chunk < diff_hdr);
+
+	if (last && diff_hdr)
+		chunk = diff_hdr;
 
-		parse_chunk_lineno(&lineno, chunk->data, line->type == LINE_DIFF_DEL ? '+' : '-');
+	stage_delete_lines(view, chunk, end - chunk, to_lineno);
+	return chunk;
+}
 
-		while (context < line) {
-			if (context->type == LINE_DIFF_CHUNK || context->type == LINE_DIFF_HEADER) {
+/* Update the lines of the view to show the changes between from and to
+ * as applied so the diff does not have to be reloaded. */
+static bool
+stage_patch_view(struct view *view, struct line *from, struct line *to, bool reverse)
+{
+	struct stage_state *state = view->private;
+	unsigned long from_lineno = from - view->line;
+	unsigned long to_lineno = to - view->line;
+	struct line *chunk = stage_first_chunk(view, from);
+	struct line *diff_hdr = NULL;
+	long shift = 0, trim;
+
+	state->diff.index.valid = FALSE;
+
+	while (chunk) {
+		struct line *file = diff_find_prev_line_by_type(view, chunk, LINE_DIFF_HEADER);
+		struct chunk_header header;
+		unsigned long old_lines = 0, new_lines = 0;
+		bool changes = FALSE;
+		char buf[SIZEOF_STR];
+		const char *context;
+		struct line *pos;
+
+		if (file != diff_hdr) {
+			if (chunk - view->line > to_lineno)
 				break;
-			} else if (context->type != LINE_DIFF_DEL && context->type != LINE_DIFF_ADD) {
-				lineno++;
+			diff_hdr = file;
+			shift = 0;
+		}
+
+		if (prefixcmp(chunk->data, "@@ -") ||
+		    !parse_chunk_header(&header, chunk->data))
+			return FALSE;
+
+		for (pos = chunk + 1; view_has_line(view, pos); ) {
+			char *data = pos->data;
+			unsigned long lineno = pos - view->line;
+
+			if (pos->type == LINE_DIFF_CHUNK || pos->type == LINE_DIFF_HEADER)
+				break;
+
+			if (from_lineno <= lineno && lineno <= to_lineno &&
+			    (*data == '+' || *data == '-')) {
+				if (*data == (reverse ? '-' : '+')) {
+					*data = ' ';
+					pos->type = get_line_type(data);
+					pos->dirty = 1;
+
+				} else {
+					delete_line(view, pos);
+					to_lineno--;
+					if (view_has_line(view, pos) && *(char *) pos->data == '\\') {
+						delete_line(view, pos);
+						if (lineno <= to_lineno)
+							to_lineno--;
+					}
+					continue;
+				}
 			}
-			context++;
+
+			if (*data == ' ' || *data == '-')
+				old_lines++;
+			if (*data == ' ' || *data == '+')
+				new_lines++;
+			if (*data == '+' || *data == '-')
+				changes = TRUE;
+			pos++;
 		}
 
-		if (!stage_diff_write(&io, diff_hdr, chunk) ||
-		    !io_printf(&io, "@@ -%lu%s +%lu%s @@\n",
-			       lineno, markers[0], lineno, markers[1]) ||
-		    !stage_diff_write(&io, line, line + 1)) {
-			chunk = NULL;
+		if (reverse) {
+			header.new.position = stage_chunk_position(header.new.position + shift,
+								   header.new.lines, new_lines);
+			shift += (long) new_lines - (long) header.new.lines;
+		} else {
+			header.old.position = stage_chunk_position(header.old.position + shift,
+								   header.old.lines, old_lines);
+			shift += (long) old_lines - (long) header.old.lines;
 		}
-	} else {
-		if (!stage_diff_write(&io, diff_hdr, chunk) ||
-		    !stage_diff_write(&io, chunk, view->line + view->lines))
-			chunk = NULL;
+
+		if (!changes) {
+			chunk = stage_delete_chunk(view, chunk, pos, &to_lineno);
+			if (chunk <= diff_hdr)
+				diff_hdr = NULL;
+			chunk = diff_find_next_line_by_type(view, chunk, LINE_DIFF_CHUNK);
+			continue;
+		}
+
+		/* Trim context exceeding what Git shows around changes. */
+		trim = stage_context_lines(chunk + 1, pos, 1) - opt_diff_context;
+		if (trim > 0) {
+			header.old.position += trim;
+			header.new.position += trim;
+			old_lines -= trim;
+			new_lines -= trim;
+			pos -= trim;
+			stage_delete_lines(view, chunk + 1, trim, &to_lineno);
+		}
+
+		trim = stage_context_lines(pos - 1, chunk, -1) - opt_diff_context;
+		if (trim > 0) {
+			old_lines -= trim;
+			new_lines -= trim;
+			pos -= trim;
+			stage_delete_lines(view, pos, trim, &to_lineno);
+		}
+
+		context = strstr(chunk->data + STRING_SIZE("@@ -"), "@@");
+		if (!string_format(buf, "@@ -%lu,%lu +%lu,%lu %s",
+				   header.old.position, old_lines,
+				   header.new.position, new_lines,
+				   context ? context : "@@"))
+			return FALSE;
+
+		free(chunk->data);
+		chunk->data = strdup(buf);
+		if (!chunk->data)
+			return FALSE;
+		chunk->dirty = 1;
+
+		chunk = diff_find_next_line_by_type(view, pos, LINE_DIFF_CHUNK);
+	}
+
+	return diff_find_next_line_by_type(view, view->line, LINE_DIFF_CHUNK) != NULL;
+}
+
+static struct line *
+stage_next_change(struct view *view, struct line *line)
+{
+	struct line *chunk, *pos;
+
+	for (chunk = stage_first_chunk(view, line); chunk;
+	     chunk = diff_find_next_line_by_type(view, chunk + 1, LINE_DIFF_CHUNK)) {
+		struct line *end = stage_chunk_end(view, chunk);
+
+		for (pos = MAX(line, chunk + 1); pos < end; pos++)
+			if (pos->type == LINE_DIFF_ADD || pos->type == LINE_DIFF_DEL)
+				return pos;
+	}
+
+	return NULL;
+}
+
+DEFINE_ALLOCATOR(realloc_verify_lines, char *, 8)
+
+/* Background comparison of the diff updated in place with the one from
+ * Git. It is kept outside the view state, which is cleared on reload. */
+static struct {
+	struct view *view;
+	struct io io;
+	unsigned long lineno;		/* Next line to compare. */
+	bool in_diff;			/* Whether the diff stat has been read. */
+	char **stat;			/* Lines read before the first diff. */
+	size_t stat_size;
+	bool changed;			/* Whether lines were updated in place. */
+} stage_verify;
+
+static void
+stage_stop_verify(void)
+{
+	size_t i;
+
+	if (stage_verify.view) {
+		io_kill(&stage_verify.io);
+		io_done(&stage_verify.io);
+	}
+
+	for (i = 0; i < stage_verify.stat_size; i++)
+		free(stage_verify.stat[i]);
+	free(stage_verify.stat);
+	memset(&stage_verify, 0, sizeof(stage_verify));
+}
+
+static bool
+stage_start_verify(struct view *view)
+{
+	struct line *diff_hdr = diff_find_next_line_by_type(view, view->line, LINE_DIFF_HEADER);
+
+	if (!diff_hdr || !io_run(&stage_verify.io, IO_RD, view->dir, opt_env, view->argv))
+		return FALSE;
+
+	stage_verify.view = view;
+	stage_verify.lineno = diff_hdr - view->line;
+	return TRUE;
+}
+
+static bool
+stage_verify_line(struct view *view, const char *data)
+{
+	const char *context;
+	struct line *line;
+
+	if (!stage_verify.in_diff && get_line_type(data) != LINE_DIFF_HEADER) {
+		char *stat = strdup(data);
+
+		if (!stat || !realloc_verify_lines(&stage_verify.stat, stage_verify.stat_size, 1)) {
+			free(stat);
+			return FALSE;
+		}
+
+		stage_verify.stat[stage_verify.stat_size++] = stat;
+		return TRUE;
+	}
+
+	stage_verify.in_diff = TRUE;
+	if (stage_verify.lineno >= view->lines)
+		return FALSE;
+
+	line = &view->line[stage_verify.lineno++];
+	if (!strcmp(line->data, data))
+		return TRUE;
+
+	/* Blob ids and the chunk context are not updated in place. */
+	if (prefixcmp(data, "index ") || prefixcmp(line->data, "index ")) {
+		if (line->type != LINE_DIFF_CHUNK || prefixcmp(data, "@@ -") ||
+		    !(context = strstr(data + STRING_SIZE("@@ -"), "@@")) ||
+		    strncmp(line->data, data, context - data))
+			return FALSE;
+	}
+
+	free(line->data);
+	line->data = strdup(data);
+	line->dirty = 1;
+	stage_verify.changed = TRUE;
+	return line->data != NULL;
+}
+
+/* Take the diff stat from Git once the diff is known to match. */
+static bool
+stage_finish_verify(struct view *view)
+{
+	struct stage_state *state = view->private;
+	struct line *diff_hdr = diff_find_next_line_by_type(view, view->line, LINE_DIFF_HEADER);
+	bool ok = io_done(&stage_verify.io);
+	unsigned long stat_lines;
+	long delta;
+	size_t i;
+
+	stage_verify.view = NULL;
+	if (!ok || !stage_verify.in_diff || stage_verify.lineno != view->lines || !diff_hdr)
+		return FALSE;
+
+	stat_lines = diff_hdr - view->line;
+	if (stat_lines == stage_verify.stat_size) {
+		bool changed = stage_verify.changed;
+
+		for (i = 0; i < stat_lines; i++) {
+			if (strcmp(view->line[i].data, stage_verify.stat[i])) {
+				free(view->line[i].data);
+				view->line[i].data = stage_verify.stat[i];
+				view->line[i].dirty = 1;
+				stage_verify.stat[i] = NULL;
+				changed = TRUE;
+			}
+		}
+
+		if (changed) {
+			reset_search_results(view);
+			reset_line_widths(view);
+		}
+		return TRUE;
+	}
+
+	/* Files were dropped from the diff stat. */
+	state->diff.index.valid = FALSE;
+	for (i = 0; i < stat_lines; i++)
+		delete_line(view, view->line);
+
+	for (i = 0; i < stage_verify.stat_size; i++) {
+		const char *stat = stage_verify.stat[i];
+		enum line_type type = strchr(stat, '|') ? LINE_DIFF_STAT : LINE_DEFAULT;
+
+		if (!add_line_at(view, i, stat, type, strlen(stat) + 1, FALSE))
+			return FALSE;
+	}
+
+	delta = (long) stage_verify.stat_size - (long) stat_lines;
+	view->pos.lineno = MAX((long) view->pos.lineno + delta, 0);
+	view->pos.offset = MAX((long) view->pos.offset + delta, 0);
+	return TRUE;
+}
+
+/* Read the output of the background diff. Returns TRUE while it is
+ * running. */
+static bool
+stage_poll(struct view *view)
+{
+	struct encoding *encoding = view->encoding ? view->encoding : default_encoding;
+	bool can_read = TRUE;
+	char *line;
+
+	if (stage_verify.view != view)
+		return FALSE;
+
+	if (!view_is_displayed(view)) {
+		stage_stop_verify();
+		return FALSE;
+	}
+
+	if (!io_can_read(&stage_verify.io, FALSE))
+		return TRUE;
+
+	for (; (line = io_get(&stage_verify.io, '\n', can_read)); can_read = FALSE) {
+		if (encoding)
+			line = encoding_convert(encoding, line);
+		if (!stage_verify_line(view, line))
+			break;
+	}
+
+	if (!line && !io_eof(&stage_verify.io) && !io_error(&stage_verify.io))
+		return TRUE;
+
+	if (!line && stage_finish_verify(view)) {
+		stage_stop_verify();
+		redraw_view(view);
+		return FALSE;
+	}
+
+	stage_stop_verify();
+	refresh_view(view);
+	return FALSE;
+}
+
+static void
+stage_done(struct view *view)
+{
+	struct stage_state *state = view->private;
+
+	if (stage_verify.view == view)
+		stage_stop_verify();
+	diff_common_done(&state->diff);
+}
+
+/* Apply the changes between from and to and update the view in place
+ * when possible. The view is then verified against Git in the
+ * background. */
+static bool
+stage_apply_range(struct view *view, struct line *from, struct line *to,
+		  bool revert, bool *reload)
+{
+	struct stage_state *state = view->private;
+	unsigned long lineno = from - view->line;
+	struct line *next;
+
+	if (!stage_apply_lines(view, from, to, revert)) {
+		report(revert ? "Failed to revert changes" : "Failed to apply changes");
+		return FALSE;
 	}
 
-	io_done(&io);
+	state->selecting = FALSE;
+	state->chunks = 0;
+	stage_stop_verify();
+	if (!stage_patch_view(view, from, to, revert || stage_line_type == LINE_STAT_STAGED))
+		return TRUE;
+
+	/* Move to the next change not yet applied. */
+	next = stage_next_change(view, view->line + MIN(lineno, view->lines - 1));
+	if (!next)
+		next = stage_next_change(view, view->line);
+	if (next)
+		lineno = next - view->line;
+
+	goto_view_line(view, view->pos.offset, MIN(lineno, view->lines - 1));
+	*reload = !stage_start_verify(view);
+	return TRUE;
+}
 
-	return chunk ? TRUE : FALSE;
+/* Apply the changes in the selected range, or on the line if no range
+ * is selected. */
+static bool
+stage_apply_selection(struct view *view, struct line *line, bool revert, bool *reload)
+{
+	struct stage_state *state = view->private;
+	struct line *anchor = state->selecting ? view->line + state->select_lineno : line;
+
+	if (revert && !prompt_yesno("Are you sure you want to revert changes?"))
+		return FALSE;
+
+	return stage_apply_range(view, MIN(anchor, line), MAX(anchor, line), revert, reload);
 }
 
 static bool
-stage_update(struct view *view, struct line *line, bool single)
+stage_update(struct view *view, struct line *line, bool *reload)
 {
 	struct line *chunk = NULL;
 
 	if (!is_initial_commit() && stage_line_type != LINE_STAT_UNTRACKED)
-		chunk = find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
+		chunk = diff_find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
 
 	if (chunk) {
-		if (!stage_apply_chunk(view, chunk, single ? line : NULL, FALSE)) {
-			report("Failed to apply chunk");
-			return FALSE;
-		}
+		return stage_apply_range(view, chunk, stage_chunk_end(view, chunk) - 1,
+					 FALSE, reload);
 
 	} else if (!stage_status.status) {
 		view = view->parent;
@@ -143,22 +702,28 @@ stage_update(struct view *view, struct line *line, bool single)
 }
 
 static bool
-stage_revert(struct view *view, struct line *line)
+stage_revert(struct view *view, struct line *line, bool *reload)
 {
 	struct line *chunk = NULL;
 
 	if (!is_initial_commit() && stage_line_type == LINE_STAT_UNSTAGED)
-		chunk = find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
+		chunk = diff_find_prev_line_by_type(view, line, LINE_DIFF_CHUNK);
 
 	if (chunk) {
 		if (!prompt_yesno("Are you sure you want to revert changes?"))
 			return FALSE;
 
-		if (!stage_apply_chunk(view, chunk, NULL, TRUE)) {
-			report("Failed to revert chunk");
-			return FALSE;
-		}
-		return TRUE;
+		return stage_apply_range(view, chunk, stage_chunk_end(view, chunk) - 1,
+					 TRUE, reload);
+
+	} else if (!stage_status.status && stage_line_type == LINE_STAT_UNSTAGED) {
+		view = view->parent;
+
+		for (line = view->line; view_has_line(view, line); line++)
+			if (line->type == stage_line_type)
+				break;
+
+		return status_revert_files(view, line + 1);
 
 	} else {
 		return status_revert(stage_status.status ? &stage_status : NULL,
@@ -241,6 +806,7 @@ stage_split_chunk(struct view *view, struct line *chunk_start)
 {
 	struct chunk_header header;
 	struct line *last_changed_line = NULL, *last_unchanged_line = NULL, *pos;
+	struct stage_state *state = view->private;
 	int chunks = 0;
 
 	if (!chunk_start || !parse_chunk_header(&header, chunk_start->data)) {
@@ -248,6 +814,8 @@ stage_split_chunk(struct view *view, struct line *chunk_start)
 		return;
 	}
 
+	state->diff.index.valid = FALSE;
+
 	header.old.lines = header.new.lines = 0;
 
 	for (pos = chunk_start + 1; view_has_line(view, pos); pos++) {
@@ -297,18 +865,71 @@ stage_split_chunk(struct view *view, struct line *chunk_start)
 	}
 }
 
+static bool
+stage_draw(struct view *view, struct line *line, unsigned int lineno)
+{
+	struct stage_state *state = view->private;
+	unsigned long pos = line - view->line;
+
+	if (state->selecting && !line->selected &&
+	    MIN(state->select_lineno, view->pos.lineno) <= pos &&
+	    pos <= MAX(state->select_lineno, view->pos.lineno)) {
+		set_view_attr(view, LINE_CURSOR);
+		line->selected = TRUE;
+	}
+
+	return diff_common_draw(view, line, lineno);
+}
+
+static void
+stage_select(struct view *view, struct line *line)
+{
+	struct stage_state *state = view->private;
+	unsigned long lineno = line - view->line;
+
+	/* Redraw lines entering or leaving the selected range. Rows
+	 * recorded before a line entered the range must not be reused. */
+	if (state->selecting) {
+		unsigned long pos = MIN(state->cursor_lineno, lineno);
+		unsigned long end = MAX(state->cursor_lineno, lineno);
+
+		for (; pos <= end && pos < view->lines; pos++)
+			if (pos != lineno)
+				view->line[pos].dirty = 1;
+		reset_view_rows(view);
+	}
+
+	state->cursor_lineno = lineno;
+	pager_select(view, line);
+}
+
 static enum request
 stage_request(struct view *view, enum request request, struct line *line)
 {
+	struct stage_state *state = view->private;
+	bool reload = TRUE;
+
 	switch (request) {
 	case REQ_STATUS_UPDATE:
-		if (!stage_update(view, line, FALSE))
+		if (state->selecting) {
+			if (!stage_apply_selection(view, line, FALSE, &reload))
+				return REQ_NONE;
+		} else if (!stage_update(view, line, &reload)) {
 			return REQ_NONE;
+		}
 		break;
 
 	case REQ_STATUS_REVERT:
-		if (!stage_revert(view, line))
+		if (state->selecting) {
+			if (stage_line_type != LINE_STAT_UNSTAGED) {
+				report("Cannot revert changes to staged files");
+				return REQ_NONE;
+			}
+			if (!stage_apply_selection(view, line, TRUE, &reload))
+				return REQ_NONE;
+		} else if (!stage_revert(view, line, &reload)) {
 			return REQ_NONE;
+		}
 		break;
 
 	case REQ_STAGE_UPDATE_LINE:
@@ -317,14 +938,37 @@ stage_request(struct view *view, enum request request, struct line *line)
 			report("Staging single lines is not supported for new files");
 			return REQ_NONE;
 		}
-		if (line->type != LINE_DIFF_DEL && line->type != LINE_DIFF_ADD) {
+		if (!state->selecting &&
+		    line->type != LINE_DIFF_DEL && line->type != LINE_DIFF_ADD) {
 			report("Please select a change to stage");
 			return REQ_NONE;
 		}
-		if (!stage_update(view, line, TRUE))
+		if (is_initial_commit()) {
+			if (!stage_update(view, line, &reload))
+				return REQ_NONE;
+		} else if (!stage_apply_selection(view, line, FALSE, &reload)) {
 			return REQ_NONE;
+		}
 		break;
 
+	case REQ_STAGE_SELECT_RANGE:
+		if (state->selecting) {
+			state->selecting = FALSE;
+			reset_view_rows(view);
+			redraw_view(view);
+			report_clear();
+		} else if (stage_line_type == LINE_STAT_UNTRACKED ||
+			   stage_status.status == 'A' || is_initial_commit()) {
+			report("Selecting lines is not supported for new files");
+		} else {
+			state->selecting = TRUE;
+			state->select_lineno = state->cursor_lineno = line - view->line;
+			report("Selecting lines; press %s to stage or %s to revert them",
+			       get_view_key(view, REQ_STATUS_UPDATE),
+			       get_view_key(view, REQ_STATUS_REVERT));
+		}
+		return REQ_NONE;
+
 	case REQ_STAGE_NEXT:
 		if (stage_line_type == LINE_STAT_UNTRACKED) {
 			report("File is untracked; press %s to add",
@@ -336,7 +980,7 @@ stage_request(struct view *view, enum request request, struct line *line)
 
 	case REQ_STAGE_SPLIT_CHUNK:
 		if (stage_line_type == LINE_STAT_UNTRACKED ||
-		    !(line = find_prev_line_by_type(view, line, LINE_DIFF_CHUNK))) {
+		    !(line = diff_find_prev_line_by_type(view, line, LINE_DIFF_CHUNK))) {
 			report("No chunks to split in sight");
 			return REQ_NONE;
 		}
@@ -407,7 +1051,10 @@ stage_request(struct view *view, enum request request, struct line *line)
 		return REQ_VIEW_CLOSE;
 	}
 
-	refresh_view(view);
+	if (reload)
+		refresh_view(view);
+	else
+		redraw_view(view);
 
 	return REQ_NONE;
 }
@@ -504,10 +1151,12 @@ struct view_ops stage_ops = {
 	sizeof(struct stage_state),
 	stage_open,
 	stage_read,
-	diff_common_draw,
+	stage_draw,
 	stage_request,
 	pager_grep,
-	pager_select,
+	stage_select,
+	stage_done,
+	stage_poll,
 };
 
 /* vim: set ts=8 sw=8 noexpandtab: */
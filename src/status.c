@@ -21,12 +21,14 @@
 #include "tig/draw.h"
 #include "tig/git.h"
 #include "tig/status.h"
+#include "tig/watch.h"
 
 /*
  * Status backend
  */
 
 static char status_onbranch[SIZEOF_STR];
+static char status_head[SIZEOF_REV];
 struct status stage_status;
 enum line_type stage_line_type;
 
@@ -161,6 +163,16 @@ const char *update_index_argv[] = {
 	"git", "update-index", "-q", "--unmerged", "--refresh", NULL
 };
 
+/* Used for refreshing the status of changed paths. Since the index is
+ * not refreshed, use git-diff(1) which ignores stat-only changes. */
+static const char *status_diff_files_paths_argv[] = {
+	"git", "diff", "--raw", "-z", "--no-abbrev", "--no-renames", "--no-color", "--", NULL
+};
+
+static const char *status_list_other_paths_argv[] = {
+	"git", "ls-files", "-z", "--others", "--exclude-standard", "--", NULL
+};
+
 /* Restore the previous line number to stay in the context or select a
  * line with something that can be updated. */
 void
@@ -238,6 +250,230 @@ status_update_onbranch(void)
 	string_copy(status_onbranch, "Not currently on any branch");
 }
 
+static bool
+status_path_matches(const char *name, const char *path)
+{
+	size_t pathlen = strlen(path);
+	size_t namelen = strlen(name);
+
+	/* Either the file itself, a file in a changed directory or an
+	 * untracked directory containing the changed file. */
+	if (!strncmp(name, path, pathlen) && (!name[pathlen] || name[pathlen] == '/'))
+		return TRUE;
+	return namelen && name[namelen - 1] == '/' && !strncmp(path, name, namelen);
+}
+
+static bool
+status_has_path(struct status *status, const char **paths)
+{
+	int i;
+
+	for (i = 0; paths && paths[i]; i++)
+		if (status_path_matches(status->new.name, paths[i]) ||
+		    status_path_matches(status->old.name, paths[i]))
+			return TRUE;
+
+	return !paths;
+}
+
+static struct line *
+status_find_section(struct view *view, enum line_type type)
+{
+	struct line *line;
+
+	for (line = view->line; view_has_line(view, line); line++)
+		if (line->type == type && !line->data)
+			return line;
+
+	return NULL;
+}
+
+static void
+status_free_section(struct view *section)
+{
+	int i;
+
+	for (i = 0; i < section->lines; i++)
+		free(section->line[i].data);
+	free(section->line);
+}
+
+/* Replace the entries of a section matching the given paths with the
+ * output of the section command limited to those paths. When paths is
+ * NULL the whole section is replaced and when argv is NULL the matching
+ * entries are only removed. */
+static bool
+status_reload_section(struct view *view, const char *argv[], char status,
+		      enum line_type type, const char **paths)
+{
+	struct view section = {};
+	struct line *header = status_find_section(view, type);
+	unsigned long pos;
+	bool ok = TRUE;
+	int i;
+
+	if (!header)
+		return FALSE;
+
+	if (argv && !status_run(&section, argv, status, type)) {
+		status_free_section(&section);
+		return FALSE;
+	}
+
+	pos = header - view->line + 1;
+	while (pos < view->lines && view->line[pos].type == type) {
+		if (status_has_path(view->line[pos].data, paths))
+			delete_line(view, &view->line[pos]);
+		else
+			pos++;
+	}
+
+	for (i = 0; i < section.lines; i++) {
+		struct status *file = section.line[i].data;
+		int cmp = 1;
+
+		if (!file)
+			continue;
+
+		pos = header - view->line + 1;
+		while (pos < view->lines && view->line[pos].type == type) {
+			struct status *entry = view->line[pos].data;
+
+			cmp = strcmp(entry->new.name, file->new.name);
+			if (cmp >= 0)
+				break;
+			pos++;
+		}
+
+		if (cmp && !add_line_at(view, pos, file, type, sizeof(*file), FALSE)) {
+			ok = FALSE;
+			break;
+		}
+		header = status_find_section(view, type);
+	}
+
+	status_free_section(&section);
+	if (!ok)
+		return FALSE;
+
+	/* Keep the "(no files)" line only for empty sections. */
+	pos = header - view->line + 1;
+	if (pos < view->lines && view->line[pos].type == type) {
+		while (pos < view->lines && view->line[pos].type == type)
+			pos++;
+		if (pos < view->lines && view->line[pos].type == LINE_STAT_NONE)
+			delete_line(view, &view->line[pos]);
+
+	} else if (pos >= view->lines || view->line[pos].type != LINE_STAT_NONE) {
+		if (!add_line_at(view, pos, NULL, LINE_STAT_NONE, 0, FALSE))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static bool
+status_append_paths(const char ***argv, const char *src_argv[], const char **paths, bool in_prefix)
+{
+	size_t prefixlen = strlen(repo.prefix);
+	int i;
+
+	if (!argv_append(argv, "git") ||
+	    !argv_append(argv, "--literal-pathspecs") ||
+	    !argv_append_array(argv, src_argv + 1))
+		return FALSE;
+
+	for (i = 0; paths[i]; i++) {
+		const char *path = paths[i];
+
+		/* Limit untracked files to the prefix similar to the
+		 * full listing. */
+		if (in_prefix && prefixlen && strncmp(path, repo.prefix, prefixlen)) {
+			if (!status_path_matches(repo.prefix, path))
+				continue;
+			path = repo.prefix;
+		}
+
+		if (!argv_append(argv, path))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Reload only the status of paths reported as changed by the working
+ * tree watcher. Returns FALSE if the view must be fully reloaded. */
+static bool
+status_reload_paths(struct view *view)
+{
+	const char **changed;
+	const char **paths = NULL;
+	const char **staged_argv = NULL;
+	const char **unstaged_argv = NULL;
+	const char **untracked_argv = NULL;
+	size_t changed_size, i;
+	bool ok;
+
+	if (!opt_watch_worktree || !view->lines ||
+	    !watch_get_paths(&changed, &changed_size) ||
+	    is_initial_commit() || strcmp(status_head, get_ref_head()->id))
+		return FALSE;
+
+	ok = TRUE;
+	for (i = 0; ok && i < changed_size; i++)
+		ok = argv_append(&paths, changed[i]);
+
+	/* Query both names of renamed entries to keep detecting them. */
+	for (i = 0; ok && i < view->lines; i++) {
+		struct status *status = view->line[i].data;
+
+		if (view->line[i].type == LINE_STAT_STAGED && status &&
+		    strcmp(status->old.name, status->new.name) &&
+		    status_has_path(status, paths))
+			ok = argv_append(&paths, status->old.name) &&
+			     argv_append(&paths, status->new.name);
+	}
+
+	status_update_onbranch();
+
+	if (ok && paths) {
+		ok = status_append_paths(&staged_argv, status_diff_index_argv, paths, FALSE) &&
+		     status_append_paths(&unstaged_argv, status_diff_files_paths_argv, paths, FALSE) &&
+		     status_append_paths(&untracked_argv, status_list_other_paths_argv, paths, TRUE);
+
+		ok = ok &&
+		     status_reload_section(view, staged_argv, 0, LINE_STAT_STAGED, paths) &&
+		     status_reload_section(view, unstaged_argv, 0, LINE_STAT_UNSTAGED, paths);
+
+		/* Untracked directories are listed without their content
+		 * and cannot be reloaded per path. */
+		if (ok && opt_status_untracked_dirs) {
+			/* No changed paths may be left inside the prefix. */
+			if (argv_size(untracked_argv) <= ARRAY_SIZE(status_list_other_paths_argv))
+				argv_free(untracked_argv);
+			ok = status_reload_section(view, *untracked_argv ? untracked_argv : NULL,
+						   '?', LINE_STAT_UNTRACKED, paths);
+		} else if (ok) {
+			ok = status_reload_section(view, status_list_other_argv, '?', LINE_STAT_UNTRACKED, NULL);
+		}
+	}
+
+	argv_free(paths);
+	free(paths);
+	argv_free(staged_argv);
+	free(staged_argv);
+	argv_free(unstaged_argv);
+	free(unstaged_argv);
+	argv_free(untracked_argv);
+	free(untracked_argv);
+
+	if (!ok)
+		return FALSE;
+
+	watch_reset();
+	return TRUE;
+}
+
 /* First parse staged info using git-diff-index(1), then parse unstaged
  * info using git-diff-files(1), and finally untracked files using
  * git-ls-files(1). */
@@ -253,15 +489,29 @@ status_open(struct view *view, enum open_flags flags)
 		return FALSE;
 	}
 
+	status_list_other_argv[ARRAY_SIZE(status_list_other_argv) - 2] =
+		opt_status_untracked_dirs ? NULL : "--directory";
+
+	if ((flags & OPEN_REFRESH) && status_reload_paths(view)) {
+		view->prev_pos = view->pos;
+		clear_position(&view->pos);
+		status_restore(view);
+		return TRUE;
+	}
+
 	reset_view(view);
 
 	add_line_nodata(view, LINE_STAT_HEAD);
 	status_update_onbranch();
 
-	io_run_bg(update_index_argv);
+	if (opt_watch_worktree)
+		watch_init();
 
-	status_list_other_argv[ARRAY_SIZE(status_list_other_argv) - 2] =
-		opt_status_untracked_dirs ? NULL : "--directory";
+	watch_index_begin();
+	io_run_bg(update_index_argv);
+	watch_index_end();
+	watch_reset();
+	string_copy_rev(status_head, is_initial_commit() ? "" : get_ref_head()->id);
 
 	if (!status_run(view, staged_argv, staged_status, LINE_STAT_STAGED) ||
 	    !status_run(view, status_diff_files_argv, 0, LINE_STAT_UNSTAGED) ||
@@ -442,17 +692,29 @@ status_update_write(struct io *io, struct status *status, enum line_type type)
 	}
 }
 
+/* Tell the working tree watcher about changes made by Tig. */
+static void
+status_watch_index_end(struct status *status)
+{
+	watch_mark_path(status->old.name);
+	watch_mark_path(status->new.name);
+	watch_index_end();
+}
+
 bool
 status_update_file(struct status *status, enum line_type type)
 {
 	struct io io;
 	bool result;
 
+	watch_index_begin();
 	if (!status_update_prepare(&io, type))
 		return FALSE;
 
 	result = status_update_write(&io, status, type);
-	return io_done(&io) && result;
+	result = io_done(&io) && result;
+	status_watch_index_end(status);
+	return result;
 }
 
 bool
@@ -466,6 +728,7 @@ status_update_files(struct view *view, struct line *line)
 	int file, done;
 	int cursor_y = -1, cursor_x = -1;
 
+	watch_index_begin();
 	if (!status_update_prepare(&io, line->type))
 		return FALSE;
 
@@ -489,7 +752,15 @@ status_update_files(struct view *view, struct line *line)
 	}
 	string_copy(view->ref, buf);
 
-	return io_done(&io) && result;
+	result = io_done(&io) && result;
+	for (pos = line - file; pos < line; pos++) {
+		struct status *status = pos->data;
+
+		watch_mark_path(status->old.name);
+		watch_mark_path(status->new.name);
+	}
+	watch_index_end();
+	return result;
 }
 
 static bool
@@ -542,6 +813,9 @@ status_revert(struct status *status, enum line_type type, bool has_none)
 			"git", "checkout", "--", status->old.name, NULL
 		};
 
+		bool result = TRUE;
+
+		watch_index_begin();
 		if (status->status == 'U') {
 			string_format(mode, "%5o", status->old.mode);
 
@@ -551,18 +825,70 @@ status_revert(struct status *status, enum line_type type, bool has_none)
 				reset_argv[4] = NULL;
 			}
 
-			if (!io_run_fg(reset_argv, repo.cdup))
-				return FALSE;
-			if (status->old.mode == 0 && status->new.mode == 0)
-				return TRUE;
+			result = io_run_fg(reset_argv, repo.cdup);
 		}
 
-		return io_run_fg(checkout_argv, repo.cdup);
+		if (result && (status->status != 'U' || status->old.mode || status->new.mode))
+			result = io_run_fg(checkout_argv, repo.cdup);
+
+		status_watch_index_end(status);
+		return result;
 	}
 
 	return FALSE;
 }
 
+/* Revert all files of the unstaged section with a single checkout. */
+bool
+status_revert_files(struct view *view, struct line *line)
+{
+	const char *checkout_argv[] = {
+		"git", "checkout-index", "-f", "-z", "--stdin", NULL
+	};
+	char prompt[SIZEOF_STR];
+	struct io io;
+	bool result = TRUE;
+	struct line *pos;
+	int files = 0;
+
+	for (pos = line; view_has_line(view, pos) && pos->data; pos++) {
+		struct status *status = pos->data;
+
+		if (status->status == 'U') {
+			report("Cannot revert changes to multiple files with unmerged entries");
+			return FALSE;
+		}
+		files++;
+	}
+
+	if (!files) {
+		report("Nothing to revert");
+		return FALSE;
+	}
+
+	if (!string_format(prompt, "Are you sure you want to revert changes to %d files?", files) ||
+	    !prompt_yesno(prompt))
+		return FALSE;
+
+	watch_index_begin();
+	if (!io_run(&io, IO_WR, repo.cdup, opt_env, checkout_argv)) {
+		watch_index_end();
+		return FALSE;
+	}
+
+	for (pos = line; result && pos < line + files; pos++) {
+		struct status *status = pos->data;
+
+		result = io_printf(&io, "%s%c", status->old.name, 0);
+	}
+
+	result = io_done(&io) && result;
+	for (pos = line; pos < line + files; pos++)
+		watch_mark_path(((struct status *) pos->data)->old.name);
+	watch_index_end();
+	return result;
+}
+
 static void
 open_mergetool(const char *file)
 {
@@ -583,8 +909,13 @@ status_request(struct view *view, enum request request, struct line *line)
 		break;
 
 	case REQ_STATUS_REVERT:
-		if (!status_revert(status, line->type, status_has_none(view, line)))
+		if (!status && line->type == LINE_STAT_UNSTAGED &&
+		    !status_has_none(view, line)) {
+			if (!status_revert_files(view, line + 1))
+				return REQ_NONE;
+		} else if (!status_revert(status, line->type, status_has_none(view, line))) {
 			return REQ_NONE;
+		}
 		break;
 
 	case REQ_STATUS_MERGE:
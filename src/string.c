@@ -312,6 +312,36 @@ utf8_to_unicode(const char *string, size_t length)
 	return unicode > 0xffff ? 0 : unicode;
 }
 
+/* Word-at-a-time checks for runs of ASCII characters. */
+#define ASCII_WORD_ONES		(~0UL / 255)
+#define ASCII_WORD_HIGHS	(ASCII_WORD_ONES * 0x80)
+#define ASCII_WORD_HAS_ZERO(word) \
+	(((word) - ASCII_WORD_ONES) & ~(word) & ASCII_WORD_HIGHS)
+
+/* Get the length of the run of ASCII characters at the start of string
+ * which are one column wide, i.e. all but tabs. Checks a word at a time
+ * before checking the remaining bytes one by one. */
+static size_t
+utf8_ascii_length(const char *string, const char *end)
+{
+	const char *pos = string;
+
+	while (end - pos >= sizeof(unsigned long)) {
+		unsigned long word;
+
+		memcpy(&word, pos, sizeof(word));
+		if ((word & ASCII_WORD_HIGHS) ||
+		    ASCII_WORD_HAS_ZERO(word ^ (ASCII_WORD_ONES * '\t')))
+			break;
+		pos += sizeof(word);
+	}
+
+	while (pos < end && (unsigned char) *pos < 0x80 && *pos != '\t')
+		pos++;
+
+	return pos - string;
+}
+
 /* Calculates how much of string can be shown within the given maximum width
  * and sets trimmed parameter to non-zero value if all of string could not be
  * shown. If the reserve flag is TRUE, it will reserve at least one
@@ -330,10 +360,29 @@ utf8_length(const char **start, size_t skip, int *width, size_t max_width, int *
 	*trimmed = 0;
 
 	while (string < end) {
-		unsigned char bytes = utf8_char_length(string, end);
+		unsigned char bytes;
 		size_t ucwidth;
 		unsigned long unicode;
 
+		/* Consume runs of single-width ASCII characters which fit
+		 * within the maximum width without decoding them. */
+		if ((unsigned char) *string < 0x80 && *string != '\t') {
+			size_t fits = max_width - *width;
+			size_t ascii = utf8_ascii_length(string, end - string > fits ? string + fits : end);
+
+			if (ascii > 0) {
+				size_t skipped = MIN(skip, ascii);
+
+				skip -= skipped;
+				*start += skipped;
+				*width += ascii;
+				string += ascii;
+				last_bytes = last_ucwidth = 1;
+				continue;
+			}
+		}
+
+		bytes = utf8_char_length(string, end);
 		if (string + bytes > end)
 			break;
 
@@ -87,6 +87,17 @@ view_request(struct view *view, enum request request)
 	_(UNTRACKED_DIRS, 'd', "untracked directory info", &opt_status_untracked_dirs, NULL, VIEW_STATUS_LIKE), \
 	_(VERTICAL_SPLIT, '|', "view split",   &opt_vertical_split, vertical_split_map, VIEW_FLAG_RESET_DISPLAY), \
 
+/* Options can change the text that is searched in views. */
+static void
+reset_view_search_results(void)
+{
+	struct view *view;
+	int i;
+
+	foreach_view(view, i)
+		reset_search_results(view);
+}
+
 static enum view_flag
 toggle_option(struct view *view, enum request request, char msg[SIZEOF_STR])
 {
@@ -357,6 +368,7 @@ view_driver(struct view *view, enum request request)
 			char action[SIZEOF_STR] = "";
 			enum view_flag flags = toggle_option(view, request, action);
 	
+			reset_view_search_results();
 			if (flags == VIEW_FLAG_RESET_DISPLAY) {
 				resize_display();
 				redraw_display(TRUE);
@@ -395,6 +407,8 @@ view_driver(struct view *view, enum request request)
 		break;
 
 	case REQ_STOP_LOADING:
+		if (stop_search())
+			report("Stopped searching");
 		foreach_view(view, i) {
 			if (view->pipe)
 				report("Stopped loading the %s view", view->name),
@@ -700,6 +714,7 @@ run_prompt_command(struct view *view, char *cmd)
 		if (args) {
 			*args++ = 0;
 			if (set_option(cmd, args) == SUCCESS) {
+				reset_view_search_results();
 				request = !view->unrefreshable ? REQ_REFRESH : REQ_SCREEN_REDRAW;
 				if (!strcmp(cmd, "color"))
 					init_colors();
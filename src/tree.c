@@ -68,18 +68,21 @@ push_tree_stack_entry(struct view *view, const char *name, struct position *posi
 
 struct tree_entry {
 	char id[SIZEOF_REV];
-	char commit[SIZEOF_REV];
+	struct commit_info *commit;	/* Last commit changing the entry. */
 	mode_t mode;
-	struct time time;		/* Date from the author ident. */
-	const struct ident *author;	/* Author of the commit. */
 	unsigned long size;
 	char name[1];
 };
 
+static struct time no_time;
+
+#define tree_entry_author(entry) \
+	((entry)->commit ? (entry)->commit->author : NULL)
+#define tree_entry_time(entry) \
+	((entry)->commit ? &(entry)->commit->time : &no_time)
+
 struct tree_state {
-	char commit[SIZEOF_REV];
-	const struct ident *author;
-	struct time author_time;
+	struct commit_info *commit;	/* Commit being read from the log. */
 	int size_width;
 	bool read_date;
 };
@@ -118,10 +121,10 @@ tree_compare(const void *l1, const void *l2)
 
 	switch (get_sort_field(tree_sort_state)) {
 	case ORDERBY_DATE:
-		return sort_order(tree_sort_state, timecmp(&entry1->time, &entry2->time));
+		return sort_order(tree_sort_state, timecmp(tree_entry_time(entry1), tree_entry_time(entry2)));
 
 	case ORDERBY_AUTHOR:
-		return sort_order(tree_sort_state, ident_compare(entry1->author, entry2->author));
+		return sort_order(tree_sort_state, ident_compare(tree_entry_author(entry1), tree_entry_author(entry2)));
 
 	case ORDERBY_NAME:
 	default:
@@ -155,13 +158,16 @@ static bool
 tree_read_date(struct view *view, char *text, struct tree_state *state)
 {
 	if (!text && state->read_date) {
+		put_commit_info(state->commit);
+		state->commit = NULL;
 		state->read_date = FALSE;
 		return TRUE;
 
 	} else if (!text) {
 		/* Find next entry to process */
 		const char *log_file[] = {
-			"git", "log", encoding_arg, "--no-color", "--pretty=raw",
+			"git", "log", encoding_arg, "--no-color", "--date=raw",
+				"--pretty=format:commit %H%nauthor %aN <%aE> %ad",
 				"--cc", "--raw", view->ops->id, "--", "%(directory)", NULL
 		};
 
@@ -181,13 +187,20 @@ tree_read_date(struct view *view, char *text, struct tree_state *state)
 		return FALSE;
 
 	} else if (*text == 'c' && get_line_type(text) == LINE_COMMIT) {
-		string_copy_rev_from_commit_line(state->commit, text);
+		char id[SIZEOF_REV];
+
+		string_copy_rev_from_commit_line(id, text);
+		put_commit_info(state->commit);
+		state->commit = get_commit_info(id);
 
 	} else if (*text == 'a' && get_line_type(text) == LINE_AUTHOR) {
-		parse_author_line(text + STRING_SIZE("author "),
-				  &state->author, &state->author_time);
+		/* Reuse metadata already known from other views. The author
+		 * is mailmapped like the one read by the blame view. */
+		if (state->commit && !state->commit->author)
+			parse_author_line(text + STRING_SIZE("author "),
+					  &state->commit->author, &state->commit->time);
 
-	} else if (*text == ':') {
+	} else if (*text == ':' && state->commit) {
 		char *pos;
 		size_t annotated = 1;
 		size_t i;
@@ -206,13 +219,11 @@ tree_read_date(struct view *view, char *text, struct tree_state *state)
 			struct line *line = &view->line[i];
 			struct tree_entry *entry = line->data;
 
-			annotated += !!entry->author;
-			if (entry->author || strcmp(entry->name, text))
+			annotated += !!entry->commit;
+			if (entry->commit || strcmp(entry->name, text))
 				continue;
 
-			string_copy_rev(entry->commit, state->commit);
-			entry->author = state->author;
-			entry->time = state->author_time;
+			entry->commit = get_commit_info(state->commit->id);
 			line->dirty = 1;
 			break;
 		}
@@ -305,17 +316,17 @@ tree_draw(struct view *view, struct line *line, unsigned int lineno)
 		if (draw_mode(view, entry->mode))
 			return TRUE;
 
-		if (draw_author(view, entry->author))
+		if (draw_author(view, tree_entry_author(entry)))
 			return TRUE;
 
 		if (draw_file_size(view, entry->size, state->size_width,
 				   line->type != LINE_TREE_FILE))
 			return TRUE;
 
-		if (draw_date(view, &entry->time))
+		if (draw_date(view, tree_entry_time(entry)))
 			return TRUE;
 
-		if (draw_id(view, entry->commit))
+		if (draw_id(view, entry->commit ? entry->commit->id : NULL))
 			return TRUE;
 	}
 
@@ -441,14 +452,32 @@ tree_grep(struct view *view, struct line *line)
 	struct tree_entry *entry = line->data;
 	const char *text[] = {
 		entry->name,
-		mkauthor(entry->author, opt_author_width, opt_show_author),
-		mkdate(&entry->time, opt_show_date),
+		mkauthor(tree_entry_author(entry), opt_author_width, opt_show_author),
+		mkdate(tree_entry_time(entry), opt_show_date),
 		NULL
 	};
 
 	return grep_text(view, text);
 }
 
+static void
+tree_done(struct view *view)
+{
+	struct tree_state *state = view->private;
+	size_t i;
+
+	for (i = 0; i < view->lines; i++) {
+		struct tree_entry *entry = view->line[i].data;
+
+		put_commit_info(entry->commit);
+	}
+
+	/* The view may be reset while the dates are being read. */
+	put_commit_info(state->commit);
+	state->commit = NULL;
+	state->read_date = FALSE;
+}
+
 static void
 tree_select(struct view *view, struct line *line)
 {
@@ -520,6 +549,7 @@ struct view_ops tree_ops = {
 	tree_request,
 	tree_grep,
 	tree_select,
+	tree_done,
 };
 
 /* vim: set ts=8 sw=8 noexpandtab: */
@@ -72,8 +72,8 @@ timecmp(const struct time *t1, const struct time *t2)
 	return t1->sec - t2->sec;
 }
 
-const char *
-mkdate(const struct time *time, enum date date)
+static const char *
+format_date(const struct time *time, enum date date, time_t now)
 {
 	static char buf[DATE_WIDTH + 1];
 	static const struct enum_map_entry reldate[] = {
@@ -87,17 +87,12 @@ mkdate(const struct time *time, enum date date)
 	};
 	struct tm tm;
 
-	if (!date || !time || !time->sec)
-		return "";
-
 	if (date == DATE_RELATIVE) {
-		struct timeval now;
 		time_t date = time->sec + time->tz;
 		time_t seconds;
 		int i;
 
-		gettimeofday(&now, NULL);
-		seconds = now.tv_sec < date ? date - now.tv_sec : now.tv_sec - date;
+		seconds = now < date ? date - now : now - date;
 		for (i = 0; i < ARRAY_SIZE(reldate); i++) {
 			if (seconds >= reldate[i].value && reldate[i].value)
 				continue;
@@ -106,7 +101,7 @@ mkdate(const struct time *time, enum date date)
 			if (!string_format(buf, "%ld %s%s %s",
 					   seconds, reldate[i].name,
 					   seconds > 1 ? "s" : "",
-					   now.tv_sec >= date ? "ago" : "ahead"))
+					   now >= date ? "ago" : "ahead"))
 				break;
 			return buf;
 		}
@@ -122,6 +117,52 @@ mkdate(const struct time *time, enum date date)
 	return strftime(buf, sizeof(buf), DATE_FORMAT, &tm) ? buf : NULL;
 }
 
+/* Formatted dates are cached by time and date format. Relative dates
+ * are only reused within the second they were formatted. */
+#define DATE_CACHE_SIZE	256
+
+static struct date_cache {
+	time_t sec;
+	int tz;
+	enum date date;
+	time_t now;
+	char text[DATE_WIDTH + 1];
+} date_cache[DATE_CACHE_SIZE];
+
+const char *
+mkdate(const struct time *time, enum date date)
+{
+	struct date_cache *entry;
+	const char *text;
+	time_t now = 0;
+
+	if (!date || !time || !time->sec)
+		return "";
+
+	if (date == DATE_RELATIVE) {
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		now = tv.tv_sec;
+	}
+
+	entry = &date_cache[(unsigned long) (time->sec + time->tz) % DATE_CACHE_SIZE];
+	if (entry->sec == time->sec && entry->tz == time->tz &&
+	    entry->date == date && entry->now == now)
+		return entry->text;
+
+	text = format_date(time, date, now);
+	if (!text)
+		return NULL;
+
+	string_ncopy(entry->text, text, strlen(text));
+	entry->sec = time->sec;
+	entry->tz = time->tz;
+	entry->date = date;
+	entry->now = now;
+	return entry->text;
+}
+
 const char *
 mkfilesize(unsigned long size, enum file_size format)
 {
@@ -222,6 +263,37 @@ get_email_user(const char *email)
 	return user;
 }
 
+/* The initials and email users of authors are cached by ident, which
+ * are shared by all commits with the same author. */
+#define AUTHOR_CACHE_SIZE	256
+
+static struct author_cache {
+	const struct ident *ident;
+	enum author author;
+	char *text;
+} author_cache[AUTHOR_CACHE_SIZE];
+
+static const char *
+get_cached_author(const struct ident *ident, enum author author)
+{
+	unsigned long hash = (unsigned long) ident / sizeof(*ident) + author;
+	struct author_cache *entry = &author_cache[hash % AUTHOR_CACHE_SIZE];
+	const char *text;
+
+	if (entry->ident == ident && entry->author == author)
+		return entry->text;
+
+	text = author == AUTHOR_EMAIL_USER
+	     ? get_email_user(ident->email)
+	     : get_author_initials(ident->name);
+
+	free(entry->text);
+	entry->text = strdup(text);
+	entry->ident = entry->text ? ident : NULL;
+	entry->author = author;
+	return entry->text ? entry->text : text;
+}
+
 const char *
 mkauthor(const struct ident *ident, int cols, enum author author)
 {
@@ -233,9 +305,9 @@ mkauthor(const struct ident *ident, int cols, enum author author)
 	if (author == AUTHOR_EMAIL && ident->email)
 		return ident->email;
 	if (author == AUTHOR_EMAIL_USER && ident->email)
-		return get_email_user(ident->email);
+		return get_cached_author(ident, AUTHOR_EMAIL_USER);
 	if (abbreviate && ident->name)
-		return get_author_initials(ident->name);
+		return get_cached_author(ident, AUTHOR_ABBREVIATED);
 	return ident->name;
 }
 
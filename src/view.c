@@ -87,6 +87,7 @@ do_scroll_view(struct view *view, int lines)
 
 		if (redraw_current_line)
 			draw_view_line(view, view->pos.lineno - view->pos.offset);
+		redraw_view_dirty(view);
 		wnoutrefresh(view->win);
 	}
 
@@ -251,6 +252,8 @@ move_view(struct view *view, enum request request)
 
 	/* Draw the current line */
 	draw_view_line(view, view->pos.lineno - view->pos.offset);
+	/* Lines invalidated when selecting the current line. */
+	redraw_view_dirty(view);
 
 	wnoutrefresh(view->win);
 	report_clear();
@@ -260,6 +263,38 @@ move_view(struct view *view, enum request request)
  * Searching
  */
 
+/* Find the first match in a string. The offsets of the match are
+ * stored in match and flags are passed to regexec(). */
+bool
+grep_match(struct view *view, const char *text, regmatch_t *match, int flags)
+{
+	const char *pos;
+
+	if (!view->grep_literal)
+		return !regexec(view->regex, text, 1, match, flags);
+
+	if (!view->grep_icase) {
+		pos = strstr(text, view->grep);
+
+	} else {
+		/* Find candidates for the first character with
+		 * strpbrk() and compare the rest of the string. */
+		char first[] = { tolower(*view->grep), toupper(*view->grep), 0 };
+		size_t len = strlen(view->grep);
+
+		for (pos = text; (pos = strpbrk(pos, first)); pos++)
+			if (!strncasecmp(pos, view->grep, len))
+				break;
+	}
+
+	if (!pos)
+		return FALSE;
+
+	match->rm_so = pos - text;
+	match->rm_eo = match->rm_so + strlen(view->grep);
+	return TRUE;
+}
+
 bool
 grep_text(struct view *view, const char *text[])
 {
@@ -267,11 +302,31 @@ grep_text(struct view *view, const char *text[])
 	size_t i;
 
 	for (i = 0; text[i]; i++)
-		if (*text[i] && !regexec(view->regex, text[i], 1, &pmatch, 0))
+		if (*text[i] && grep_match(view, text[i], &pmatch, 0))
 			return TRUE;
+
 	return FALSE;
 }
 
+/* Whether a search string matches the same strings as a substring
+ * search, which is the case when it has no regexp operators. Ignoring
+ * case is limited to ASCII strings. */
+static bool
+search_is_literal(const char *search, bool icase)
+{
+	if (!*search)
+		return FALSE;
+
+	for (; *search; search++) {
+		if (strchr(".[]()*+?{}|^$\\", *search))
+			return FALSE;
+		if (icase && (unsigned char) *search >= 0x80)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 void
 select_view_line(struct view *view, unsigned long lineno)
 {
@@ -292,6 +347,274 @@ select_view_line(struct view *view, unsigned long lineno)
 	}
 }
 
+/*
+ * Searches run in slices so input is handled while a large view is
+ * searched. The first slice is run when the search is started and the
+ * rest from the input loop via update_search(). A forward search keeps
+ * waiting for lines while the view is loading.
+ */
+
+#define SEARCH_SLICE_LINES	1024	/* Lines to search between time checks. */
+#define SEARCH_SLICE_USECS	20000	/* Time to search before handling input. */
+
+static struct view_search {
+	struct view *view;
+	unsigned long start;
+	unsigned long lineno;
+	int direction;
+} view_search;
+
+static long
+search_elapsed_usecs(struct timeval *start)
+{
+	struct timeval now;
+
+	if (gettimeofday(&now, NULL))
+		return 0;
+	return (now.tv_sec - start->tv_sec) * 1000000 + now.tv_usec - start->tv_usec;
+}
+
+/*
+ * Search results are recorded per line in a pair of bitmaps once the view
+ * has been loaded, so lines are only searched once per search string.
+ * Lines that are known not to match are skipped a word at a time and the
+ * total number of matches is counted in the background. The bitmaps are
+ * reset when the lines of a view are changed.
+ */
+
+#define SEARCH_BITS	(sizeof(unsigned long) * 8)
+
+DEFINE_ALLOCATOR(realloc_search_bits, unsigned long, 1024)
+
+void
+reset_search_results(struct view *view)
+{
+	free(view->grep_searched);
+	free(view->grep_matched);
+	view->grep_searched = view->grep_matched = NULL;
+	view->grep_bitmap_size = 0;
+	view->grep_counted = 0;
+	view->grep_matches = 0;
+	/* Rendered rows show the searched text and its highlights. */
+	reset_view_rows(view);
+}
+
+static bool
+search_bitmap_alloc(struct view *view, unsigned long lines)
+{
+	size_t size = (lines + SEARCH_BITS - 1) / SEARCH_BITS;
+	size_t increase = size - view->grep_bitmap_size;
+
+	if (size <= view->grep_bitmap_size)
+		return TRUE;
+
+	if (!realloc_search_bits(&view->grep_searched, view->grep_bitmap_size, increase) ||
+	    !realloc_search_bits(&view->grep_matched, view->grep_bitmap_size, increase))
+		return FALSE;
+
+	view->grep_bitmap_size = size;
+	return TRUE;
+}
+
+static bool
+search_line_is_recorded(struct view *view, unsigned long lineno)
+{
+	size_t word = lineno / SEARCH_BITS;
+
+	return word < view->grep_bitmap_size &&
+	       (view->grep_searched[word] & (1UL << (lineno % SEARCH_BITS)));
+}
+
+bool
+search_line_matches(struct view *view, struct line *line)
+{
+	unsigned long lineno = line - view->line;
+
+	return *view->grep && search_line_is_recorded(view, lineno) &&
+	       (view->grep_matched[lineno / SEARCH_BITS] & (1UL << (lineno % SEARCH_BITS)));
+}
+
+static bool
+search_view_line(struct view *view, unsigned long lineno)
+{
+	unsigned long bit = 1UL << (lineno % SEARCH_BITS);
+	size_t word = lineno / SEARCH_BITS;
+	bool matched;
+
+	if (search_line_is_recorded(view, lineno))
+		return !!(view->grep_matched[word] & bit);
+
+	matched = view->ops->grep(view, &view->line[lineno]);
+
+	/* Lines of loading views may still be updated. */
+	if (!view->pipe && search_bitmap_alloc(view, lineno + 1)) {
+		view->grep_searched[word] |= bit;
+		if (matched)
+			view->grep_matched[word] |= bit;
+	}
+
+	return matched;
+}
+
+/* Get the next line to search when the word of lineno is known to have
+ * no matches. */
+static unsigned long
+search_skip_lines(struct view *view, unsigned long lineno, int direction)
+{
+	size_t word = lineno / SEARCH_BITS;
+
+	if (word >= view->grep_bitmap_size ||
+	    view->grep_searched[word] != ~0UL ||
+	    view->grep_matched[word])
+		return lineno;
+
+	return direction > 0 ? (word + 1) * SEARCH_BITS : word * SEARCH_BITS - 1;
+}
+
+static bool
+search_is_counted(struct view *view)
+{
+	return !view->pipe && view->grep_counted >= view->lines;
+}
+
+static unsigned int
+search_count_bits(unsigned long word)
+{
+	unsigned int bits = 0;
+
+	for (; word; word &= word - 1)
+		bits++;
+	return bits;
+}
+
+/* Get the number of the match on lineno, counting from one. */
+static size_t
+search_match_number(struct view *view, unsigned long lineno)
+{
+	size_t word = lineno / SEARCH_BITS;
+	unsigned int shift = SEARCH_BITS - 1 - lineno % SEARCH_BITS;
+	size_t number = search_count_bits(view->grep_matched[word] << shift);
+	size_t i;
+
+	for (i = 0; i < word; i++)
+		number += search_count_bits(view->grep_matched[i]);
+	return number;
+}
+
+/* Returns TRUE while matches are still being counted. */
+static bool
+search_count_matches(struct view *view)
+{
+	struct timeval start;
+	size_t lines = 0;
+
+	if (!*view->grep || search_is_counted(view) || view->pipe ||
+	    !search_bitmap_alloc(view, view->lines))
+		return FALSE;
+
+	gettimeofday(&start, NULL);
+
+	while (view->grep_counted < view->lines) {
+		if (search_view_line(view, view->grep_counted++))
+			view->grep_matches++;
+
+		if (++lines % SEARCH_SLICE_LINES == 0 &&
+		    search_elapsed_usecs(&start) >= SEARCH_SLICE_USECS)
+			return TRUE;
+	}
+
+	/* Highlight the matches found while counting. */
+	if (view_is_displayed(view))
+		redraw_view(view);
+	return FALSE;
+}
+
+static void
+report_search_match(struct view *view, unsigned long lineno)
+{
+	if (search_is_counted(view) && search_line_is_recorded(view, lineno))
+		report("Line %ld matches '%s' (%zu of %zu)", lineno + 1, view->grep,
+		       search_match_number(view, lineno), view->grep_matches);
+	else
+		report("Line %ld matches '%s'", lineno + 1, view->grep);
+}
+
+/* Returns TRUE while the search is still running. */
+static bool
+search_view_lines(struct view *view, struct view_search *search)
+{
+	struct timeval start;
+	size_t lines = 0;
+
+	gettimeofday(&start, NULL);
+
+	/* Note, lineno is unsigned long so will wrap around in which case it
+	 * will become bigger than view->lines. */
+	while (search->lineno < view->lines) {
+		unsigned long next = search_skip_lines(view, search->lineno, search->direction);
+
+		if (next != search->lineno) {
+			search->lineno = next;
+			continue;
+		}
+
+		if (search_view_line(view, search->lineno)) {
+			unsigned long lineno = search->lineno;
+
+			search->view = NULL;
+			select_view_line(view, lineno);
+			report_search_match(view, lineno);
+			return FALSE;
+		}
+
+		search->lineno += search->direction;
+		if (++lines % SEARCH_SLICE_LINES == 0 &&
+		    search_elapsed_usecs(&start) >= SEARCH_SLICE_USECS)
+			return TRUE;
+	}
+
+	if (search->direction > 0 && view->pipe)
+		return TRUE;
+
+	search->view = NULL;
+	report("No match found for '%s'", view->grep);
+	return FALSE;
+}
+
+static unsigned int
+search_progress(struct view *view, struct view_search *search)
+{
+	unsigned long total = search->direction > 0 ? view->lines - search->start : search->start + 1;
+	unsigned long done = search->direction > 0 ? search->lineno - search->start : search->start - search->lineno;
+
+	return total && done < total ? done * 100 / total : 100;
+}
+
+bool
+update_search(struct view *view)
+{
+	bool running;
+
+	if (view_search.view != view)
+		return search_count_matches(view);
+
+	running = search_view_lines(view, &view_search);
+	if (view_is_displayed(view))
+		update_view_title(view);
+	return running;
+}
+
+bool
+stop_search(void)
+{
+	struct view *view = view_search.view;
+
+	view_search.view = NULL;
+	if (view && view_is_displayed(view))
+		update_view_title(view);
+	return view != NULL;
+}
+
 void
 find_next(struct view *view, enum request request)
 {
@@ -324,17 +647,14 @@ find_next(struct view *view, enum request request)
 	if (request == REQ_FIND_NEXT || request == REQ_FIND_PREV)
 		lineno += direction;
 
-	/* Note, lineno is unsigned long so will wrap around in which case it
-	 * will become bigger than view->lines. */
-	for (; lineno < view->lines; lineno += direction) {
-		if (view->ops->grep(view, &view->line[lineno])) {
-			select_view_line(view, lineno);
-			report("Line %ld matches '%s'", lineno + 1, view->grep);
-			return;
-		}
-	}
+	view_search.view = view;
+	view_search.start = view_search.lineno = lineno;
+	view_search.direction = direction;
 
-	report("No match found for '%s'", view->grep);
+	if (search_view_lines(view, &view_search)) {
+		report("Searching for '%s'", view->grep);
+		update_view_title(view);
+	}
 }
 
 void
@@ -361,7 +681,10 @@ search_view(struct view *view, enum request request)
 		return;
 	}
 
+	reset_search_results(view);
 	string_copy(view->grep, view->env->search);
+	view->grep_icase = opt_ignore_case;
+	view->grep_literal = search_is_literal(view->grep, view->grep_icase);
 
 	find_next(view, request);
 }
@@ -438,6 +761,11 @@ reset_view(struct view *view)
 	if (view->ops->done)
 		view->ops->done(view);
 
+	if (view_search.view == view)
+		view_search.view = NULL;
+	reset_search_results(view);
+	reset_line_widths(view);
+
 	for (i = 0; i < view->lines; i++)
 		free(view->line[i].data);
 	free(view->line);
@@ -675,6 +1003,9 @@ update_view_title(struct view *view)
 			wprintw(window, " loading %lds", secs);
 	}
 
+	if (view_search.view == view)
+		wprintw(window, " searching %u%%", search_progress(view, &view_search));
+
 	view_lines = view->pos.offset + view->height;
 	lines = view->lines ? MIN(view_lines, view->lines) * 100 / view->lines : 0;
 	mvwprintw(window, 0, view->width - count_digits(lines) - 1, "%d%%", lines);
@@ -869,11 +1200,12 @@ add_line_at(struct view *view, unsigned long pos, const void *data, enum line_ty
 	}
 
 	if (pos < view->lines) {
+		reset_search_results(view);
 		view->lines++;
 		line = view->line + pos;
 		lineno = line->lineno;
 
-		memmove(line + 1, line, (view->lines - pos) * sizeof(*view->line));
+		memmove(line + 1, line, (view->lines - pos - 1) * sizeof(*view->line));
 		while (pos < view->lines) {
 			view->line[pos].lineno++;
 			view->line[pos++].dirty = 1;
@@ -934,6 +1266,25 @@ add_line_format(struct view *view, enum line_type type, const char *fmt, ...)
 	return retval >= 0 ? add_line_text(view, buf, type) : NULL;
 }
 
+void
+delete_line(struct view *view, struct line *line)
+{
+	unsigned long pos = line - view->line;
+
+	assert(view_has_line(view, line));
+
+	reset_search_results(view);
+	reset_line_widths(view);
+	free(line->data);
+	view->lines--;
+	memmove(line, line + 1, (view->lines - pos) * sizeof(*view->line));
+	while (pos < view->lines) {
+		if (view->line[pos].lineno)
+			view->line[pos].lineno--;
+		view->line[pos++].dirty = 1;
+	}
+}
+
 /*
  * Global view state.
  */
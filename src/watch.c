@@ -0,0 +1,564 @@
+/* Copyright (c) 2006-2014 Jonas Fonseca <jonas.fonseca@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "tig/tig.h"
+#include "tig/argv.h"
+#include "tig/io.h"
+#include "tig/repo.h"
+#include "tig/options.h"
+#include "tig/display.h"
+#include "tig/watch.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+#include <dirent.h>
+#include <sys/inotify.h>
+
+#define WATCH_MASK \
+	(IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+	 IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW)
+
+enum watch_dir_type {
+	WATCH_DIR_NONE,
+	WATCH_DIR_WORKTREE,	/* Directory in the working tree. */
+	WATCH_DIR_GIT,		/* The Git directory holding the index. */
+	WATCH_DIR_GIT_LOGS,	/* The Git directory logs holding HEAD's reflog. */
+};
+
+struct watch_dir {
+	enum watch_dir_type type;
+	char *path;		/* Path relative to the working tree root. */
+};
+
+static struct watch_state {
+	int fd;			/* The inotify file descriptor. */
+	bool failed;		/* Watching failed and should not be retried. */
+	struct watch_dir *dirs;	/* Watched directories indexed by descriptor. */
+	size_t dirs_size;
+	char **ignored;		/* Sorted list of ignored directories. */
+	size_t ignored_size;
+	char **paths;		/* Changed paths since the last reset. */
+	size_t paths_size;
+	bool all_changed;	/* Changes can no longer be tracked by path. */
+	bool index_changed;	/* The index was written since the last poll. */
+	bool has_index_stat;
+	struct stat index_stat;	/* Stat info of the last index written by Tig. */
+	unsigned long generation;
+} watch = { -1 };
+
+DEFINE_ALLOCATOR(realloc_watch_dirs, struct watch_dir, 64)
+DEFINE_ALLOCATOR(realloc_watch_paths, char *, 32)
+
+static void
+watch_free_paths(char **paths, size_t *paths_size)
+{
+	size_t i;
+
+	for (i = 0; i < *paths_size; i++)
+		free(paths[i]);
+	*paths_size = 0;
+}
+
+static void
+watch_changed_all(void)
+{
+	watch.all_changed = TRUE;
+	watch.generation++;
+	watch_free_paths(watch.paths, &watch.paths_size);
+}
+
+static int
+watch_compare_paths(const void *p1, const void *p2)
+{
+	return strcmp(*(const char **) p1, *(const char **) p2);
+}
+
+static bool
+watch_is_ignored(const char *path)
+{
+	return watch.ignored_size &&
+	       bsearch(&path, watch.ignored, watch.ignored_size,
+		       sizeof(*watch.ignored), watch_compare_paths);
+}
+
+/* Run git-check-ignore(1) on paths and remove the ignored ones. */
+static bool
+watch_filter_ignored(char **paths, size_t *paths_size)
+{
+	const char **argv = NULL;
+	struct io io;
+	char *name;
+	size_t i;
+	bool ok;
+
+	ok = argv_append(&argv, "git") && argv_append(&argv, "check-ignore") &&
+	     argv_append(&argv, "-z") && argv_append(&argv, "--");
+	for (i = 0; ok && i < *paths_size; i++)
+		ok = argv_append(&argv, paths[i]);
+
+	if (ok)
+		ok = io_run(&io, IO_RD, repo.cdup, opt_env, argv);
+	argv_free(argv);
+	free(argv);
+	if (!ok)
+		return FALSE;
+
+	while ((name = io_get(&io, 0, TRUE))) {
+		for (i = 0; i < *paths_size; i++) {
+			if (strcmp(paths[i], name))
+				continue;
+			free(paths[i]);
+			paths[i] = paths[--*paths_size];
+			break;
+		}
+	}
+
+	/* Exit code 1 means no paths were ignored. */
+	io_done(&io);
+	return !io_error(&io);
+}
+
+static void
+watch_add_path(const char *path)
+{
+	char *copy;
+	size_t i;
+
+	watch.generation++;
+	if (watch.all_changed)
+		return;
+
+	for (i = 0; i < watch.paths_size; i++)
+		if (!strcmp(watch.paths[i], path))
+			return;
+
+	/* Builds writing to ignored files next to tracked files can
+	 * quickly fill the list. Drop those before giving up. */
+	if (watch.paths_size >= WATCH_MAX_PATHS &&
+	    !watch_filter_ignored(watch.paths, &watch.paths_size)) {
+		watch_changed_all();
+		return;
+	}
+
+	if (watch.paths_size >= WATCH_MAX_PATHS ||
+	    !realloc_watch_paths(&watch.paths, watch.paths_size, 1) ||
+	    !(copy = strdup(path))) {
+		watch_changed_all();
+		return;
+	}
+
+	watch.paths[watch.paths_size++] = copy;
+}
+
+static bool
+watch_add_dir(const char *dirname, const char *path, enum watch_dir_type type)
+{
+	int wd = inotify_add_watch(watch.fd, dirname, WATCH_MASK);
+	char *copy;
+
+	if (wd < 0)
+		return FALSE;
+
+	if (wd >= watch.dirs_size) {
+		if (!realloc_watch_dirs(&watch.dirs, watch.dirs_size, wd + 1 - watch.dirs_size))
+			return FALSE;
+		watch.dirs_size = wd + 1;
+	}
+
+	copy = strdup(path);
+	if (!copy)
+		return FALSE;
+
+	free(watch.dirs[wd].path);
+	watch.dirs[wd].path = copy;
+	watch.dirs[wd].type = type;
+	return TRUE;
+}
+
+static bool
+watch_is_subdir(const char *path, const char *dir)
+{
+	size_t dirlen = strlen(dir);
+
+	return !strncmp(path, dir, dirlen) && (!path[dirlen] || path[dirlen] == '/');
+}
+
+/* Add watches for all directories below path except for ignored
+ * directories and nested repositories. */
+static bool
+watch_add_tree(const char *path)
+{
+	char dirname[SIZEOF_STR];
+	struct dirent *entry;
+	DIR *dir;
+
+	if (watch_is_ignored(path))
+		return TRUE;
+
+	if (!string_format(dirname, "%s%s", repo.cdup, *path ? path : "."))
+		return FALSE;
+
+	if (!watch_add_dir(dirname, path, WATCH_DIR_WORKTREE))
+		/* The directory may already be gone. */
+		return errno != ENOSPC && errno != ENOMEM;
+
+	dir = opendir(dirname);
+	if (!dir)
+		return TRUE;
+
+	while ((entry = readdir(dir))) {
+		char subpath[SIZEOF_STR];
+		char gitpath[SIZEOF_STR];
+		struct stat st;
+
+		if (!strcmp(entry->d_name, ".") ||
+		    !strcmp(entry->d_name, "..") ||
+		    !strcmp(entry->d_name, ".git"))
+			continue;
+
+		if (!string_format(subpath, "%s%s%s", path, *path ? "/" : "", entry->d_name) ||
+		    !string_format(gitpath, "%s%s/.git", repo.cdup, subpath))
+			continue;
+
+		if (entry->d_type != DT_DIR) {
+			if (entry->d_type != DT_UNKNOWN ||
+			    !string_format(dirname, "%s%s", repo.cdup, subpath) ||
+			    lstat(dirname, &st) < 0 || !S_ISDIR(st.st_mode))
+				continue;
+		}
+
+		/* Skip submodules and other nested repositories. */
+		if (!lstat(gitpath, &st))
+			continue;
+
+		if (!watch_add_tree(subpath)) {
+			closedir(dir);
+			return FALSE;
+		}
+	}
+
+	closedir(dir);
+	return TRUE;
+}
+
+static void
+watch_remove_tree(const char *path)
+{
+	int wd;
+
+	for (wd = 0; wd < watch.dirs_size; wd++) {
+		struct watch_dir *dir = &watch.dirs[wd];
+
+		if (dir->type == WATCH_DIR_WORKTREE && watch_is_subdir(dir->path, path))
+			inotify_rm_watch(watch.fd, wd);
+	}
+}
+
+static bool
+watch_is_ignored_dir(const char *path)
+{
+	const char *argv[] = { "git", "check-ignore", "-q", "--", path, NULL };
+	struct io io;
+
+	return io_run(&io, IO_BG, repo.cdup, opt_env, argv) && io_done(&io);
+}
+
+static void
+watch_handle_worktree(struct watch_dir *dir, struct inotify_event *event)
+{
+	char path[SIZEOF_STR];
+
+	if (!strcmp(event->name, ".git"))
+		return;
+
+	/* Ignore rules may change for any path below. */
+	if (!strcmp(event->name, ".gitignore") ||
+	    !string_format(path, "%s%s%s", dir->path, *dir->path ? "/" : "", event->name)) {
+		watch_changed_all();
+		return;
+	}
+
+	if (event->mask & IN_ISDIR) {
+		if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			watch_remove_tree(path);
+
+		if ((event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+		    !watch_is_ignored_dir(path) &&
+		    !watch_add_tree(path))
+			watch_changed_all();
+	}
+
+	watch_add_path(path);
+}
+
+static void
+watch_handle_event(struct inotify_event *event)
+{
+	struct watch_dir *dir;
+
+	if (event->mask & IN_Q_OVERFLOW) {
+		watch_changed_all();
+		return;
+	}
+
+	if (event->wd < 0 || event->wd >= watch.dirs_size)
+		return;
+
+	dir = &watch.dirs[event->wd];
+
+	if (event->mask & IN_IGNORED) {
+		free(dir->path);
+		dir->path = NULL;
+		dir->type = WATCH_DIR_NONE;
+		return;
+	}
+
+	if (!event->len)
+		return;
+
+	switch (dir->type) {
+	case WATCH_DIR_WORKTREE:
+		watch_handle_worktree(dir, event);
+		break;
+
+	case WATCH_DIR_GIT:
+		/* Lock files are renamed to their final name when done. */
+		if (!suffixcmp(event->name, -1, ".lock"))
+			break;
+		if (!strcmp(event->name, "index"))
+			watch.index_changed = TRUE;
+		else
+			/* HEAD, refs or merge state changed. */
+			watch_changed_all();
+		break;
+
+	case WATCH_DIR_GIT_LOGS:
+		if (!strcmp(event->name, "HEAD"))
+			watch_changed_all();
+		break;
+
+	case WATCH_DIR_NONE:
+		break;
+	}
+}
+
+static bool
+watch_stat_index(struct stat *st)
+{
+	char path[SIZEOF_STR];
+
+	return string_format(path, "%s/index", repo.git_dir) && !stat(path, st);
+}
+
+static void
+watch_poll(void)
+{
+	union {
+		struct inotify_event event;
+		char buf[8192];
+	} events;
+	ssize_t size;
+
+	while ((size = read(watch.fd, events.buf, sizeof(events.buf))) > 0) {
+		char *pos;
+
+		for (pos = events.buf; pos < events.buf + size; ) {
+			struct inotify_event *event = (struct inotify_event *) pos;
+
+			watch_handle_event(event);
+			pos += sizeof(*event) + event->len;
+		}
+	}
+
+	/* Only changes to the index made by others count. */
+	if (watch.index_changed) {
+		struct stat st;
+
+		watch.index_changed = FALSE;
+		if (!watch.has_index_stat ||
+		    !watch_stat_index(&st) ||
+		    st.st_ino != watch.index_stat.st_ino ||
+		    st.st_size != watch.index_stat.st_size ||
+		    st.st_mtim.tv_sec != watch.index_stat.st_mtim.tv_sec ||
+		    st.st_mtim.tv_nsec != watch.index_stat.st_mtim.tv_nsec)
+			watch_changed_all();
+	}
+}
+
+static bool
+watch_load_ignored(void)
+{
+	const char *argv[] = {
+		"git", "ls-files", "-z", "--others", "--ignored", "--exclude-standard",
+			"--directory", NULL
+	};
+	struct io io;
+	char *name;
+
+	if (!io_run(&io, IO_RD, repo.cdup, opt_env, argv))
+		return FALSE;
+
+	while ((name = io_get(&io, 0, TRUE))) {
+		size_t namelen = strlen(name);
+		char *dir;
+
+		if (!namelen || name[namelen - 1] != '/')
+			continue;
+
+		if (!realloc_watch_paths(&watch.ignored, watch.ignored_size, 1) ||
+		    !(dir = strndup(name, namelen - 1))) {
+			io_done(&io);
+			return FALSE;
+		}
+
+		watch.ignored[watch.ignored_size++] = dir;
+	}
+
+	qsort(watch.ignored, watch.ignored_size, sizeof(*watch.ignored),
+	      watch_compare_paths);
+	return io_done(&io);
+}
+
+static void
+watch_done(void)
+{
+	int wd;
+
+	for (wd = 0; wd < watch.dirs_size; wd++)
+		free(watch.dirs[wd].path);
+	free(watch.dirs);
+	watch.dirs = NULL;
+	watch.dirs_size = 0;
+
+	watch_free_paths(watch.ignored, &watch.ignored_size);
+	watch_free_paths(watch.paths, &watch.paths_size);
+
+	close(watch.fd);
+	watch.fd = -1;
+}
+
+bool
+watch_init(void)
+{
+	char logs[SIZEOF_STR];
+
+	if (watch.fd != -1)
+		return TRUE;
+	if (watch.failed || !repo.is_inside_work_tree || !*repo.git_dir)
+		return FALSE;
+
+	watch.failed = TRUE;
+	watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch.fd == -1)
+		return FALSE;
+
+	if (!watch_load_ignored() ||
+	    !watch_add_dir(repo.git_dir, "", WATCH_DIR_GIT) ||
+	    !string_format(logs, "%s/logs", repo.git_dir) ||
+	    !watch_add_tree("")) {
+		report("Failed to watch the working tree: %s", strerror(errno));
+		watch_done();
+		return FALSE;
+	}
+
+	/* The reflog is optional. */
+	watch_add_dir(logs, "", WATCH_DIR_GIT_LOGS);
+
+	watch.failed = FALSE;
+	watch.generation = 1;
+	return TRUE;
+}
+
+bool
+watch_is_active(void)
+{
+	return watch.fd != -1;
+}
+
+bool
+watch_get_paths(const char ***paths, size_t *paths_size)
+{
+	if (!watch_is_active())
+		return FALSE;
+
+	watch_poll();
+	if (watch.all_changed)
+		return FALSE;
+
+	*paths = (const char **) watch.paths;
+	*paths_size = watch.paths_size;
+	return TRUE;
+}
+
+void
+watch_reset(void)
+{
+	if (!watch_is_active())
+		return;
+
+	watch_poll();
+	watch_free_paths(watch.paths, &watch.paths_size);
+	watch.all_changed = FALSE;
+}
+
+unsigned long
+watch_generation(void)
+{
+	if (!watch_is_active())
+		return 0;
+
+	watch_poll();
+	return watch.generation;
+}
+
+void
+watch_mark_path(const char *path)
+{
+	if (!watch_is_active())
+		return;
+
+	if (!path || !*path)
+		watch_changed_all();
+	else
+		watch_add_path(path);
+}
+
+void
+watch_index_begin(void)
+{
+	/* Classify pending index changes before Tig writes to it. */
+	if (watch_is_active())
+		watch_poll();
+}
+
+void
+watch_index_end(void)
+{
+	if (watch_is_active())
+		watch.has_index_stat = watch_stat_index(&watch.index_stat);
+}
+
+#else
+
+bool watch_init(void) { return FALSE; }
+bool watch_is_active(void) { return FALSE; }
+bool watch_get_paths(const char ***paths, size_t *paths_size) { return FALSE; }
+void watch_reset(void) { }
+unsigned long watch_generation(void) { return 0; }
+void watch_mark_path(const char *path) { }
+void watch_index_begin(void) { }
+void watch_index_end(void) { }
+
+#endif
+
+/* vim: set ts=8 sw=8 noexpandtab: */
@@ -0,0 +1,217 @@
+/* Copyright (c) 2006-2014 Jonas Fonseca <jonas.fonseca@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "tig/tig.h"
+#include "tig/string.h"
+#include "tig/util.h"
+
+#define USAGE \
+"test-utf8-length [--benchmark]\n" \
+"\n" \
+"Compares utf8_length() with a version decoding every character for\n" \
+"generated strings. With --benchmark, times both versions instead."
+
+#define TEST_STRINGS	300000
+#define TEST_LENGTH	80
+
+#define BENCH_CALLS	200000
+#define BENCH_LENGTH	1000
+#define BENCH_WIDTH	200
+
+/* The version of utf8_length() without the fast path for ASCII runs. */
+static size_t
+utf8_length_decoded(const char **start, size_t skip, int *width, size_t max_width, int *trimmed, bool reserve, int tab_size)
+{
+	const char *string = *start;
+	const char *end = strchr(string, '\0');
+	unsigned char last_bytes = 0;
+	size_t last_ucwidth = 0;
+
+	*width = 0;
+	*trimmed = 0;
+
+	while (string < end) {
+		unsigned char bytes = utf8_char_length(string, end);
+		size_t ucwidth;
+		unsigned long unicode;
+
+		if (string + bytes > end)
+			break;
+
+		unicode = utf8_to_unicode(string, bytes);
+		if (!unicode)
+			break;
+
+		ucwidth = unicode_width(unicode, tab_size);
+		if (skip > 0) {
+			skip -= ucwidth <= skip ? ucwidth : skip;
+			*start += bytes;
+		}
+		*width  += ucwidth;
+		if (*width > max_width) {
+			*trimmed = 1;
+			*width -= ucwidth;
+			if (reserve && *width == max_width) {
+				string -= last_bytes;
+				*width -= last_ucwidth;
+			}
+			break;
+		}
+
+		string  += bytes;
+		if (ucwidth) {
+			last_bytes = bytes;
+			last_ucwidth = ucwidth;
+		} else {
+			last_bytes += bytes;
+		}
+	}
+
+	return string - *start;
+}
+
+/* Pieces covering ASCII, tabs, control characters, double- and zero-width
+ * characters, characters which are not decoded and truncated sequences. */
+static const char *pieces[] = {
+	"a", "Z", " ", "~", "\t", "\x01", "\x1f",
+	"\xc3\xa9",		/* U+00E9 */
+	"\xcc\x81",		/* U+0301, combining */
+	"\xe4\xb8\xad",		/* U+4E2D, double-width */
+	"\xe2\x82\xac",		/* U+20AC */
+	"\xf0\x9f\x98\x80",	/* U+1F600, not decoded */
+	"\x80",			/* Stray continuation byte */
+	"\xe4\xb8",		/* Truncated sequence */
+};
+
+static void
+make_string(char *buf, size_t bufsize, const char *ascii_chars, const char **set, size_t setsize)
+{
+	size_t len = 0;
+
+	while (len + 1 < bufsize) {
+		const char *piece;
+		size_t piecelen;
+
+		/* Runs of ASCII long enough to be checked a word at a time. */
+		if (ascii_chars && (!setsize || rand() % 4 == 0)) {
+			size_t run = 1 + rand() % 40;
+
+			while (run-- > 0 && len + 1 < bufsize)
+				buf[len++] = ascii_chars[rand() % strlen(ascii_chars)];
+			continue;
+		}
+
+		if (!setsize)
+			break;
+		piece = set[rand() % setsize];
+		piecelen = strlen(piece);
+		if (len + piecelen + 1 > bufsize)
+			break;
+		memcpy(buf + len, piece, piecelen);
+		len += piecelen;
+	}
+
+	buf[len] = 0;
+}
+
+static int
+test_equivalence(void)
+{
+	char buf[TEST_LENGTH + 1];
+	int failures = 0;
+	int i;
+
+	srand(1);
+
+	for (i = 0; i < TEST_STRINGS; i++) {
+		size_t skip = rand() % 12;
+		size_t max_width = rand() % 64;
+		bool reserve = rand() % 2;
+		int tab_size = 1 + rand() % 8;
+		const char *start = buf, *expected_start = buf;
+		int width, expected_width, trimmed, expected_trimmed;
+		size_t length, expected_length;
+
+		make_string(buf, 1 + rand() % sizeof(buf), "abc xyz0123456789-+|\t",
+			    pieces, ARRAY_SIZE(pieces));
+
+		length = utf8_length(&start, skip, &width, max_width, &trimmed, reserve, tab_size);
+		expected_length = utf8_length_decoded(&expected_start, skip, &expected_width,
+						      max_width, &expected_trimmed, reserve, tab_size);
+
+		if (length == expected_length && start == expected_start &&
+		    width == expected_width && trimmed == expected_trimmed)
+			continue;
+
+		if (failures++ < 10)
+			printf("# skip=%zu max_width=%zu reserve=%d tab_size=%d: "
+			       "got %zu+%zu width %d trimmed %d, expected %zu+%zu width %d trimmed %d\n",
+			       skip, max_width, reserve, tab_size,
+			       (size_t) (start - buf), length, width, trimmed,
+			       (size_t) (expected_start - buf), expected_length, expected_width, expected_trimmed);
+	}
+
+	printf("%s - utf8_length() matches the decoding version for %d strings\n",
+	       failures ? "not ok" : "ok", TEST_STRINGS);
+	return failures;
+}
+
+static double
+bench_run(size_t (*fn)(const char **, size_t, int *, size_t, int *, bool, int), const char *string)
+{
+	clock_t begin = clock();
+	int i;
+
+	for (i = 0; i < BENCH_CALLS; i++) {
+		const char *start = string;
+		int width, trimmed;
+
+		fn(&start, 0, &width, BENCH_WIDTH, &trimmed, FALSE, 8);
+	}
+
+	return (double) (clock() - begin) / CLOCKS_PER_SEC;
+}
+
+static void
+bench(const char *name, const char *string)
+{
+	printf("%-6s %.3fs -> %.3fs\n", name,
+	       bench_run(utf8_length_decoded, string),
+	       bench_run(utf8_length, string));
+}
+
+int
+main(int argc, const char *argv[])
+{
+	static const char *cjk[] = { "\xe4\xb8\xad" };
+	static const char *mixed[] = { "\xc3\xa9", "\xe4\xb8\xad" };
+	char buf[BENCH_LENGTH + 1];
+
+	if (argc > 1 && strcmp(argv[1], "--benchmark"))
+		die(USAGE);
+
+	if (argc == 1)
+		return !!test_equivalence();
+
+	srand(1);
+	make_string(buf, sizeof(buf), "abcdefghijklmnopqrstuvwxyz ", NULL, 0);
+	bench("ascii", buf);
+	make_string(buf, sizeof(buf), NULL, cjk, ARRAY_SIZE(cjk));
+	bench("cjk", buf);
+	make_string(buf, sizeof(buf), "abcdefghijklmnopqrstuvwxyz ", mixed, ARRAY_SIZE(mixed));
+	bench("mixed", buf);
+
+	return 0;
+}
+
+/* vim: set ts=8 sw=8 noexpandtab: */